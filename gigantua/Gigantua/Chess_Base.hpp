@@ -224,8 +224,7 @@ public:
 
 };
 
-std::ostream& operator<<(std::ostream& os, const BoardStatus& dt);
-std::ostream& operator<<(std::ostream& os, const BoardStatus& dt)
+inline std::ostream& operator<<(std::ostream& os, const BoardStatus& dt)
 {
     if (dt.WhiteMove) os << 'w';
     else os << "b";
@@ -453,6 +452,63 @@ enum class BoardPiece {
     Pawn, Knight, Bishop, Rook, Queen, King
 };
 
+/// <summary>
+/// Zobrist keys - generated at compile time with splitmix64.
+/// Piece index is the order of the Board members: BPawn..BKing = 0..5, WPawn..WKing = 6..11
+/// </summary>
+namespace Zobrist {
+    struct Keys {
+        uint64_t Piece[12][64];
+        uint64_t Castle[4];   //WCastleL, WCastleR, BCastleL, BCastleR
+        uint64_t EP[8];       //File of the pawn that can be taken en passant
+        uint64_t White;
+        uint64_t Depth[32];   //Folded into perft hash keys so one position can be stored for every remaining depth
+    };
+
+    static constexpr uint64_t SplitMix(uint64_t& x) {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    static constexpr Keys Generate() {
+        Keys keys{};
+        uint64_t seed = 0x476967616E747561ull;
+        for (int p = 0; p < 12; p++)
+            for (int sq = 0; sq < 64; sq++) keys.Piece[p][sq] = SplitMix(seed);
+        for (int i = 0; i < 4; i++) keys.Castle[i] = SplitMix(seed);
+        for (int i = 0; i < 8; i++) keys.EP[i] = SplitMix(seed);
+        keys.White = SplitMix(seed);
+        for (int i = 0; i < 32; i++) keys.Depth[i] = SplitMix(seed);
+        return keys;
+    }
+    static constexpr Keys Key = Generate();
+
+    template<BoardPiece piece, bool IsWhite>
+    _Compiletime int Index() {
+        return static_cast<int>(piece) + (IsWhite ? 6 : 0);
+    }
+
+    //Side to move and castling rights are part of the template - so this key is a compile time constant
+    _Compiletime uint64_t Status(const BoardStatus& status) {
+        uint64_t key = 0;
+        if (status.WhiteMove) key ^= Key.White;
+        if (status.WCastleL) key ^= Key.Castle[0];
+        if (status.WCastleR) key ^= Key.Castle[1];
+        if (status.BCastleL) key ^= Key.Castle[2];
+        if (status.BCastleR) key ^= Key.Castle[3];
+        return key;
+    }
+
+    //Key of every set bit for one piece type
+    _Inline static uint64_t Squares(int piece, map bits) {
+        uint64_t key = 0;
+        Bitloop(bits) key ^= Key.Piece[piece][SquareOf(bits)];
+        return key;
+    }
+}
+
 
 struct Board {
     const map BPawn;
@@ -581,6 +637,57 @@ struct Board {
         }
     }
 
+    //Zobrist key of the pieces - status and EP keys are added by the caller with Zobrist::Status
+    _Inline static uint64_t Hash(const Board& brd) {
+        return Zobrist::Squares(0, brd.BPawn) ^ Zobrist::Squares(1, brd.BKnight) ^ Zobrist::Squares(2, brd.BBishop) ^
+               Zobrist::Squares(3, brd.BRook) ^ Zobrist::Squares(4, brd.BQueen)  ^ Zobrist::Squares(5, brd.BKing) ^
+               Zobrist::Squares(6, brd.WPawn) ^ Zobrist::Squares(7, brd.WKnight) ^ Zobrist::Squares(8, brd.WBishop) ^
+               Zobrist::Squares(9, brd.WRook) ^ Zobrist::Squares(10, brd.WQueen) ^ Zobrist::Squares(11, brd.WKing);
+    }
+
+    //Key of the enemy piece standing on 'to' - 0 for an empty square
+    template<bool IsWhite>
+    _Inline static uint64_t HashTaken(const Board& existing, uint64_t to)
+    {
+        const Square sq = SquareOf(to);
+        constexpr int e = IsWhite ? 0 : 6;
+        if (!((IsWhite ? existing.Black : existing.White) & to)) return 0;
+        if ((IsWhite ? existing.BPawn : existing.WPawn) & to)     return Zobrist::Key.Piece[e + 0][sq];
+        if ((IsWhite ? existing.BKnight : existing.WKnight) & to) return Zobrist::Key.Piece[e + 1][sq];
+        if ((IsWhite ? existing.BBishop : existing.WBishop) & to) return Zobrist::Key.Piece[e + 2][sq];
+        if ((IsWhite ? existing.BRook : existing.WRook) & to)     return Zobrist::Key.Piece[e + 3][sq];
+        return Zobrist::Key.Piece[e + 4][sq];
+    }
+
+    //The Hash* functions return the key change of the matching Move* function
+    template<BoardPiece piece, bool IsWhite>
+    _Inline static uint64_t HashMove(const Board& existing, uint64_t from, uint64_t to)
+    {
+        constexpr int p = Zobrist::Index<piece, IsWhite>();
+        return Zobrist::Key.Piece[p][SquareOf(from)] ^ Zobrist::Key.Piece[p][SquareOf(to)] ^ HashTaken<IsWhite>(existing, to);
+    }
+
+    template<BoardPiece piece, bool IsWhite>
+    _Inline static uint64_t HashPromote(const Board& existing, uint64_t from, uint64_t to)
+    {
+        return Zobrist::Key.Piece[Zobrist::Index<BoardPiece::Pawn, IsWhite>()][SquareOf(from)] ^
+               Zobrist::Key.Piece[Zobrist::Index<piece, IsWhite>()][SquareOf(to)] ^ HashTaken<IsWhite>(existing, to);
+    }
+
+    template<bool IsWhite>
+    _Inline static uint64_t HashCastle(uint64_t kingswitch, uint64_t rookswitch)
+    {
+        return Zobrist::Squares(Zobrist::Index<BoardPiece::King, IsWhite>(), kingswitch) ^ Zobrist::Squares(Zobrist::Index<BoardPiece::Rook, IsWhite>(), rookswitch);
+    }
+
+    template<bool IsWhite>
+    _Inline static uint64_t HashEP(uint64_t from, uint64_t enemy, uint64_t to)
+    {
+        constexpr int p = Zobrist::Index<BoardPiece::Pawn, IsWhite>();
+        constexpr int e = Zobrist::Index<BoardPiece::Pawn, !IsWhite>();
+        return Zobrist::Key.Piece[p][SquareOf(from)] ^ Zobrist::Key.Piece[p][SquareOf(to)] ^ Zobrist::Key.Piece[e][SquareOf(enemy)];
+    }
+
 #ifdef _DEBUG
     _Inline uint64_t BlackPieceCount() const {
         return Bitcount(Black);
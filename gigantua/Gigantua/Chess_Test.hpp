@@ -2,6 +2,7 @@
 #include <string>
 #include <vector>
 #include <sstream>
+#include <fstream>
 #include <iostream>
 
 namespace Test {
@@ -150,5 +151,20 @@ namespace Test {
 		return splittedStrings;
 	}
 
+	//Reads an EPD perft suite in the same format as Positions: "FEN ;D1 20 ;D2 400 ...". Empty lines and # comments are skipped
+	static std::vector<std::string> ReadEPD(const std::string& path)
+	{
+		std::ifstream file(path);
+		std::string line;
+		std::vector<std::string> lines;
+		while (std::getline(file, line))
+		{
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (line.empty() || line[0] == '#') continue;
+			lines.push_back(line);
+		}
+		return lines;
+	}
+
 }
 
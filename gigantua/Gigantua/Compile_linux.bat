@@ -1,2 +1,3 @@
-wsl g++-11 Gigantua.cpp Movegen.hpp Movemap.hpp Movelist.hpp -std=c++2a -march=native -O3 -fomit-frame-pointer -foptimize-sibling-calls -o giga_gcc
-wsl clang-12 -march=native -std=c++20 -lstdc++ -O3 Gigantua.cpp -flto -o giga_clang
\ No newline at end of file
+wsl g++-11 Gigantua.cpp Movegen.hpp Movemap.hpp Movelist.hpp -std=c++2a -march=native -O3 -fomit-frame-pointer -foptimize-sibling-calls -pthread -o giga_gcc
+wsl clang-12 -march=native -std=c++20 -lstdc++ -O3 Gigantua.cpp -flto -pthread -o giga_clang
+wsl g++-11 Gigantua.cpp -std=c++2a -march=native -O3 -fomit-frame-pointer -foptimize-sibling-calls -DGIGANTUA_RUNTIME_DEPTH -pthread -o giga_runtime
\ No newline at end of file
@@ -2,17 +2,87 @@
 #include <chrono>
 #include <random>
 #include <cstring>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <memory>
 
-#include "Movelist.hpp"
+#include "Gigantua.hpp"
 #include "Chess_Test.hpp"
 
-class MoveReciever
+/// <summary>
+/// Subtree of a threaded perft. Holds everything the movestack needs for the next position 
+/// so it can be counted on any thread - run is the entry point with the compile time BoardStatus of the position
+/// </summary>
+struct PerftSplit
+{
+	Board brd;
+	map EPTarget;
+	map Atk_King;
+	map Atk_EKing;
+	map Check_Status;
+	uint64_t Hash;
+	uint64_t (*run)(const PerftSplit& split);
+};
+static std::vector<PerftSplit> PerftSplits;
+
+/// <summary>
+/// Perft hash table - caches subtree node counts by zobrist key and remaining depth. 
+/// Lockless: the key is stored xor the count so a torn entry written by two threads fails validation
+/// </summary>
+namespace PerftTT
+{
+	struct Entry {
+		std::atomic<uint64_t> key;
+		std::atomic<uint64_t> nodes;
+	};
+	static std::unique_ptr<Entry[]> Table;
+	static uint64_t Mask = 0;
+
+	static void Resize(uint64_t mb) {
+		uint64_t count = 1;
+		while (count * 2 * sizeof(Entry) <= mb * 1024 * 1024) count *= 2;
+		Table.reset(mb ? new Entry[count]() : nullptr);
+		Mask = mb ? count - 1 : 0;
+	}
+
+	static _Inline bool Enabled() {
+		return Table != nullptr;
+	}
+
+	template<class BoardStatus status, int depth>
+	static _ForceInline uint64_t Key(uint64_t hash) {
+		uint64_t key = hash ^ Zobrist::Status(status) ^ Zobrist::Key.Depth[depth];
+		if constexpr (status.HasEPPawn) key ^= Zobrist::Key.EP[SquareOf(Movelist::EnPassantTarget) & 7];
+		return key;
+	}
+
+	static _ForceInline bool Probe(uint64_t key, uint64_t& nodes) {
+		const Entry& e = Table[key & Mask];
+		const uint64_t n = e.nodes.load(std::memory_order_relaxed);
+		if ((e.key.load(std::memory_order_relaxed) ^ n) != key) return false;
+		nodes = n;
+		return true;
+	}
+
+	static _ForceInline void Store(uint64_t key, uint64_t nodes) {
+		Entry& e = Table[key & Mask];
+		e.key.store(key ^ nodes, std::memory_order_relaxed);
+		e.nodes.store(nodes, std::memory_order_relaxed);
+	}
+}
+
+//Counts perft with SplitDepth == 0. Otherwise the positions reached at SplitDepth are not counted but stored in PerftSplits
+//UseTT maintains the zobrist key on the Movestack and caches subtrees in PerftTT - without it no hashing code is generated
+template<int SplitDepth, bool UseTT>
+class PerftReciever
 {
 public:
-	static inline uint64_t nodes;
+	static inline thread_local uint64_t nodes;
 
 	static _ForceInline void Init(Board& brd, uint64_t EPInit) {
-		MoveReciever::nodes = 0;
+		nodes = 0;
 		Movelist::Init(EPInit);
 	}
 
@@ -31,16 +101,47 @@ public:
 	template<class BoardStatus status, int depth>
 	static _ForceInline void PerfT(Board& brd)
 	{
-		Movelist::EnumerateMoves<status, MoveReciever, depth>(brd);
+		Movelist::EnumerateMoves<status, PerftReciever, depth>(brd);
+	}
+
+	//Runs a stored subtree with the movestack of the current thread
+	template<class BoardStatus status, int depth>
+	static uint64_t RunSplit(const PerftSplit& split)
+	{
+		Board brd = split.brd;
+		Movestack::Atk_King[depth - 1] = split.Atk_King;
+		Movestack::Atk_EKing[depth - 1] = split.Atk_EKing;
+		Movestack::Check_Status[depth - 1] = split.Check_Status;
+		Movestack::Hash[depth - 1] = split.Hash;
+		Movelist::EnPassantTarget = split.EPTarget;
+
+		PerftReciever<0, UseTT>::nodes = 0;
+		PerftReciever<0, UseTT>::template RegisterMove<status, depth>(brd);
+		return PerftReciever<0, UseTT>::nodes;
 	}
 
 	//This method will see every position //Normal Inline - not forced - heavy recursion
 	template<class BoardStatus status, int depth>
 	static _ForceInline void RegisterMove(Board& brd)
 	{
-		if constexpr (depth == 2) {
+		if constexpr (depth == SplitDepth) {
+			PerftSplits.push_back({ brd, Movelist::EnPassantTarget, Movestack::Atk_King[depth - 1], Movestack::Atk_EKing[depth - 1], 
+				Movestack::Check_Status[depth - 1], Movestack::Hash[depth - 1], &PerftReciever<0, UseTT>::template RunSplit<status, depth> });
+		}
+		else if constexpr (depth == 2) {
 			PerfT1<status>(brd);
 		}
+		else if constexpr (UseTT) {
+			const uint64_t key = PerftTT::Key<status, depth - 1>(Movestack::Hash[depth - 1]);
+			uint64_t count;
+			if (PerftTT::Probe(key, count)) {
+				nodes += count;
+				return;
+			}
+			const uint64_t before = nodes;
+			PerfT<status, depth - 1>(brd);
+			PerftTT::Store(key, nodes - before);
+		}
 		else PerfT<status, depth - 1>(brd);
 	}
 
@@ -49,11 +150,13 @@ public:
 #define ENABLEPRINT 0
 #define IFDBG if constexpr (ENABLEDBG) 
 #define IFPRN if constexpr (ENABLEPRINT) 
+#define IFTT if constexpr (UseTT) 
 
 	template<class BoardStatus status, int depth>
 	static _Inline void Kingmove(const Board& brd, uint64_t from, uint64_t to)
 	{
 		Board next = Board::Move<BoardPiece::King, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashMove<BoardPiece::King, status.WhiteMove>(brd, from, to);
 		IFPRN std::cout << "Kingmove:\n" << _map(from, to, brd, next) << "\n";
 		//IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
 
@@ -64,35 +167,20 @@ public:
 	static _Inline void KingCastle(const Board& brd, uint64_t kingswitch, uint64_t rookswitch)
 	{
 		Board next = Board::MoveCastle<status.WhiteMove>(brd, kingswitch, rookswitch);
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashCastle<status.WhiteMove>(kingswitch, rookswitch);
 		IFPRN std::cout << "KingCastle:\n" << _map(kingswitch, rookswitch, brd, next) << "\n";
 		//IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, false);
 		RegisterMove<status.KingMove(), depth>(next);
 	}
 
-	template<class BoardStatus status, int depth>
-	static _Inline void PawnCheck(map eking, uint64_t to) {
-		constexpr bool white = status.WhiteMove;
-		map pl = Pawn_AttackLeft<white>(to & Pawns_NotLeft());
-		map pr = Pawn_AttackRight<white>(to & Pawns_NotRight());
-
-		if (eking & (pl | pr)) Movestack::Check_Status[depth - 1] = to;
-	}
-
-	template<class BoardStatus status, int depth>
-	static _Inline void KnightCheck(map eking, uint64_t to) {
-		constexpr bool white = status.WhiteMove;
-
-		if (Lookup::Knight(SquareOf(eking)) & to) Movestack::Check_Status[depth - 1] = to;
-	}
-	
-
 	template<class BoardStatus status, int depth>
 	static _Inline void Pawnmove(const Board& brd, uint64_t from, uint64_t to)
 	{
 		Board next = Board::Move<BoardPiece::Pawn, status.WhiteMove, false>(brd, from, to);
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashMove<BoardPiece::Pawn, status.WhiteMove>(brd, from, to);
 		IFPRN std::cout << "Pawnmove:\n" << _map(from, to, brd, next) << "\n";
 		//IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
-		PawnCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
+		Movelist::PawnCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
 		RegisterMove<status.SilentMove(), depth>(next);
 		Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
 	}
@@ -101,9 +189,10 @@ public:
 	static _Inline void Pawnatk(const Board& brd, uint64_t from, uint64_t to)
 	{
 		Board next = Board::Move<BoardPiece::Pawn, status.WhiteMove, true>(brd, from, to);
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashMove<BoardPiece::Pawn, status.WhiteMove>(brd, from, to);
 		IFPRN std::cout << "Pawntake:\n" << _map(from, to, brd, next) << "\n";
 		//IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
-		PawnCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
+		Movelist::PawnCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
 		RegisterMove<status.SilentMove(), depth>(next);
 		Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
 	}
@@ -112,9 +201,10 @@ public:
 	static _Inline void PawnEnpassantTake(const Board& brd, uint64_t from, uint64_t enemy, uint64_t to)
 	{
 		Board next = Board::MoveEP<status.WhiteMove>(brd, from, enemy, to);
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashEP<status.WhiteMove>(from, enemy, to);
 		IFPRN std::cout << "PawnEnpassantTake:\n" << _map(from | enemy, to, brd, next) << "\n";
 		//IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, true);
-		PawnCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
+		Movelist::PawnCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
 		RegisterMove<status.SilentMove(), depth>(next);
 		Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
 	}
@@ -123,11 +213,12 @@ public:
 	static _Inline void Pawnpush(const Board& brd, uint64_t from, uint64_t to)
 	{
 		Board next = Board::Move <BoardPiece::Pawn, status.WhiteMove, false>(brd, from, to);
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashMove<BoardPiece::Pawn, status.WhiteMove>(brd, from, to);
 		IFPRN std::cout << "Pawnpush:\n" << _map(from, to, brd, next) << "\n";
 		//IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
 
 		Movelist::EnPassantTarget = to;
-		PawnCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
+		Movelist::PawnCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
 		RegisterMove<status.PawnPush(), depth>(next);
 		Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
 	}
@@ -136,18 +227,22 @@ public:
 	static _Inline void Pawnpromote(const Board& brd, uint64_t from, uint64_t to)
 	{
 		Board next1 = Board::MovePromote<BoardPiece::Queen, status.WhiteMove>(brd, from, to);
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashPromote<BoardPiece::Queen, status.WhiteMove>(brd, from, to);
 		IFPRN std::cout << "Pawnpromote:\n" << _map(from, to, brd, next1) << "\n";
 		//IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next1, to & Enemy<status.WhiteMove>(brd));
 		RegisterMove<status.SilentMove(), depth>(next1);
 
 		Board next2 = Board::MovePromote<BoardPiece::Knight, status.WhiteMove>(brd, from, to);
-		KnightCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashPromote<BoardPiece::Knight, status.WhiteMove>(brd, from, to);
+		Movelist::KnightCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
 		RegisterMove<status.SilentMove(), depth>(next2);
 		Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
 
 		Board next3 = Board::MovePromote<BoardPiece::Bishop, status.WhiteMove>(brd, from, to);
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashPromote<BoardPiece::Bishop, status.WhiteMove>(brd, from, to);
 		RegisterMove<status.SilentMove(), depth>(next3);
 		Board next4 = Board::MovePromote<BoardPiece::Rook, status.WhiteMove>(brd, from, to);
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashPromote<BoardPiece::Rook, status.WhiteMove>(brd, from, to);
 		RegisterMove<status.SilentMove(), depth>(next4);
 	}
 
@@ -155,9 +250,10 @@ public:
 	static _Inline void Knightmove(const Board& brd, uint64_t from, uint64_t to)
 	{
 		Board next = Board::Move <BoardPiece::Knight, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashMove<BoardPiece::Knight, status.WhiteMove>(brd, from, to);
 		IFPRN std::cout << "Knightmove:\n" << _map(from, to, brd, next) << "\n";
 		//IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
-		KnightCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
+		Movelist::KnightCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
 		RegisterMove<status.SilentMove(), depth>(next);
 		Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
 	}
@@ -166,6 +262,7 @@ public:
 	static _Inline void Bishopmove(const Board& brd, uint64_t from, uint64_t to)
 	{
 		Board next = Board::Move <BoardPiece::Bishop, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashMove<BoardPiece::Bishop, status.WhiteMove>(brd, from, to);
 		IFPRN std::cout << "Bishopmove:\n" << _map(from, to, brd, next) << "\n";
 		//IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
 		RegisterMove<status.SilentMove(), depth>(next);
@@ -175,6 +272,7 @@ public:
 	static _Inline void Rookmove(const Board& brd, uint64_t from, uint64_t to)
 	{
 		Board next = Board::Move<BoardPiece::Rook, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashMove<BoardPiece::Rook, status.WhiteMove>(brd, from, to);
 		IFPRN std::cout << "Rookmove:\n" << _map(from, to, brd, next) << "\n";
 		//IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
 		if constexpr (status.CanCastle()) {
@@ -189,12 +287,67 @@ public:
 	static _Inline void Queenmove(const Board& brd, uint64_t from, uint64_t to)
 	{
 		Board next = Board::Move<BoardPiece::Queen, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+		IFTT Movestack::Hash[depth - 1] = Movestack::Hash[depth] ^ Board::HashMove<BoardPiece::Queen, status.WhiteMove>(brd, from, to);
 		IFPRN std::cout << "Queenmove:\n" << _map(from, to, brd, next) << "\n";
 		//IFDBG Board::AssertBoardMove<status.WhiteMove>(brd, next, to & Enemy<status.WhiteMove>(brd));
 		RegisterMove<status.SilentMove(), depth>(next);
 	}
 };
+using MoveReciever = PerftReciever<0, false>;
+
+static int Threads = std::max(1u, std::thread::hardware_concurrency());
+
+//Counts the stored subtrees on all threads. Idle threads take the next unclaimed subtree so the load stays balanced
+static uint64_t PerfT_RunSplits()
+{
+	std::atomic<size_t> next = 0;
+	std::atomic<uint64_t> total = 0;
+
+	auto worker = [&]() {
+		uint64_t nodes = 0;
+		for (size_t i = next++; i < PerftSplits.size(); i = next++) {
+			nodes += PerftSplits[i].run(PerftSplits[i]);
+		}
+		total += nodes;
+	};
+
+	std::vector<std::thread> pool;
+	for (int i = 1; i < Threads; i++) pool.emplace_back(worker);
+	worker();
+	for (auto& thread : pool) thread.join();
+
+	return total;
+}
+
+template<class BoardStatus status, int depth, bool UseTT>
+static void PerfT_Count(Board& brd)
+{
+	using Reciever = PerftReciever<0, UseTT>;
+	if constexpr (UseTT) Movestack::Hash[depth] = Board::Hash(brd);
+
+	//Split at ply 2 - or at the root for shallow trees - and count the subtrees on all threads
+	if constexpr (depth >= 3) {
+		if (Threads > 1) {
+			constexpr int split = depth >= 4 ? depth - 1 : depth;
+			PerftSplits.clear();
+			Movelist::EnumerateMoves<status, PerftReciever<split, UseTT>, depth>(brd);
+			MoveReciever::nodes = PerfT_RunSplits();
+			return;
+		}
+	}
+	Reciever::nodes = 0;
+	Reciever::template PerfT<status, depth>(brd);
+	MoveReciever::nodes = Reciever::nodes;
+}
+
+template<class BoardStatus status, int depth>
+static void PerfT_Root(Board& brd)
+{
+	Movelist::InitStack<status, depth>(brd);
 
+	if (PerftTT::Enabled()) PerfT_Count<status, depth, true>(brd);
+	else PerfT_Count<status, depth, false>(brd);
+}
 
 template<class BoardStatus status>
 static void PerfT(std::string_view def, Board& brd, int depth)
@@ -211,29 +364,88 @@ static void PerfT(std::string_view def, Board& brd, int depth)
 	{
 		case 0: Movelist::InitStack<status, 0>(brd); MoveReciever::PerfT0<status>(); return;
 		case 1: Movelist::InitStack<status, 1>(brd); MoveReciever::PerfT1<status>(brd); return; //Keep this as T1
-		case 2: Movelist::InitStack<status, 2>(brd); MoveReciever::PerfT<status, 2>(brd); return;
-		case 3: Movelist::InitStack<status, 3>(brd); MoveReciever::PerfT<status, 3>(brd);  return;
-		case 4: Movelist::InitStack<status, 4>(brd); MoveReciever::PerfT<status, 4>(brd);  return;
-		case 5: Movelist::InitStack<status, 5>(brd); MoveReciever::PerfT<status, 5>(brd);  return;
-		case 6: Movelist::InitStack<status, 6>(brd); MoveReciever::PerfT<status, 6>(brd);  return;
-		case 7: Movelist::InitStack<status, 7>(brd); MoveReciever::PerfT<status, 7>(brd);  return;
-		case 8: Movelist::InitStack<status, 8>(brd); MoveReciever::PerfT<status, 8>(brd);  return;
-		case 9: Movelist::InitStack<status, 9>(brd); MoveReciever::PerfT<status, 9>(brd);  return;
-		case 10: Movelist::InitStack<status, 10>(brd); MoveReciever::PerfT<status, 10>(brd); return;
-		case 11: Movelist::InitStack<status, 11>(brd); MoveReciever::PerfT<status, 11>(brd); return;
-		case 12: Movelist::InitStack<status, 12>(brd); MoveReciever::PerfT<status, 12>(brd); return;
-		case 13: Movelist::InitStack<status, 13>(brd); MoveReciever::PerfT<status, 13>(brd); return;
-		case 14: Movelist::InitStack<status, 14>(brd); MoveReciever::PerfT<status, 14>(brd); return;
-		case 15: Movelist::InitStack<status, 15>(brd); MoveReciever::PerfT<status, 15>(brd); return;
-		case 16: Movelist::InitStack<status, 16>(brd); MoveReciever::PerfT<status, 16>(brd); return;
-		case 17: Movelist::InitStack<status, 17>(brd); MoveReciever::PerfT<status, 17>(brd); return;
-		case 18: Movelist::InitStack<status, 18>(brd); MoveReciever::PerfT<status, 18>(brd); return;
+		case 2: PerfT_Root<status, 2>(brd); return;
+		case 3: PerfT_Root<status, 3>(brd); return;
+		case 4: PerfT_Root<status, 4>(brd); return;
+		case 5: PerfT_Root<status, 5>(brd); return;
+		case 6: PerfT_Root<status, 6>(brd); return;
+		case 7: PerfT_Root<status, 7>(brd); return;
+		case 8: PerfT_Root<status, 8>(brd); return;
+		case 9: PerfT_Root<status, 9>(brd); return;
+		case 10: PerfT_Root<status, 10>(brd); return;
+		case 11: PerfT_Root<status, 11>(brd); return;
+		case 12: PerfT_Root<status, 12>(brd); return;
+		case 13: PerfT_Root<status, 13>(brd); return;
+		case 14: PerfT_Root<status, 14>(brd); return;
+		case 15: PerfT_Root<status, 15>(brd); return;
+		case 16: PerfT_Root<status, 16>(brd); return;
+		case 17: PerfT_Root<status, 17>(brd); return;
+		case 18: PerfT_Root<status, 18>(brd); return;
 		default:
 			std::cout << "Depth not impl yet" << std::endl;
 			return;
 	}
 }
+#ifndef GIGANTUA_RUNTIME_DEPTH
 PositionToTemplate(PerfT);
+#endif
+
+/// <summary>
+/// Perft with the depth as a runtime value - only a single movestack depth is instantiated per BoardStatus instead of 18.
+/// Counts on the current thread
+/// </summary>
+struct RuntimePerft
+{
+	static inline thread_local uint64_t nodes;
+	static inline thread_local int depth; //Remaining depth of the position that is enumerated
+
+	template<class BoardStatus status, int>
+	static _Inline void Visit(const Board& brd, Board& next, Gigantua::Move move)
+	{
+		if (depth == 2) {
+			nodes += Gigantua::Count<status, 1>(next);
+			return;
+		}
+		depth--;
+		Gigantua::Expand<status, RuntimePerft>(next);
+		depth++;
+	}
+};
+
+template<class BoardStatus status>
+static void PerfT_Runtime(std::string_view def, Board& brd, int depth)
+{
+	MoveReciever::Init(brd, FEN::FenEnpassant(def));
+
+	if (depth <= 1) {
+		Movelist::InitStack<status, 1>(brd);
+		MoveReciever::nodes = depth == 0 ? 1 : Movelist::count<status>(brd);
+		return;
+	}
+	Movelist::InitStack<status, 2>(brd);
+	RuntimePerft::nodes = 0;
+	RuntimePerft::depth = depth;
+	Movelist::EnumerateMoves<status, Gigantua::VisitorReciever<RuntimePerft>, 2>(brd);
+	MoveReciever::nodes = RuntimePerft::nodes;
+}
+PositionToTemplate(PerfT_Runtime);
+
+//-runtime selects the runtime depth path. Building with GIGANTUA_RUNTIME_DEPTH removes the template depth path from the binary
+#ifdef GIGANTUA_RUNTIME_DEPTH
+static bool RuntimeDepth = true;
+#else
+static bool RuntimeDepth = false;
+#endif
+
+static void PerfT_Run(std::string_view def, int depth)
+{
+#ifdef GIGANTUA_RUNTIME_DEPTH
+	_PerfT_Runtime(def, depth);
+#else
+	if (RuntimeDepth) _PerfT_Runtime(def, depth);
+	else _PerfT(def, depth);
+#endif
+}
 
 void Chess_Test() {
 	for (auto pos : Test::Positions)
@@ -246,7 +458,7 @@ void Chess_Test() {
 		for (int i = 1; i < to; i++) {
 			auto perftvals = Test::GetElements(v[i], ' ');
 			uint64_t expected = static_cast<uint64_t>(std::strtol(perftvals[1].c_str(), NULL, 10));
-			_PerfT(fen, i);
+			PerfT_Run(fen, i);
 			uint64_t result = MoveReciever::nodes;
 			std::string status = expected == result ? "OK" : "ERROR";
 			if (expected == result)  std::cout << "   " << i << ": " << result << " " << status << "\n";
@@ -256,6 +468,73 @@ void Chess_Test() {
 	}
 }
 
+/// <summary>
+/// Result of one ;Dn entry of an EPD perft suite
+/// </summary>
+struct PerftResult
+{
+	int depth;
+	uint64_t expected;
+	uint64_t nodes;
+	long long us;
+};
+
+//Runs an EPD perft suite with one position per thread and prints one csv line per depth. Returns the number of mismatches
+//Each position is counted on a single core - the split at ply 2 is not used as the suite already keeps all cores busy
+static int PerfT_Suite(const std::vector<std::string>& positions, int maxdepth)
+{
+	const int workers = std::max(1, std::min(Threads, static_cast<int>(positions.size())));
+	Threads = 1;
+
+	std::vector<std::vector<PerftResult>> results(positions.size());
+	std::atomic<size_t> next = 0;
+
+	auto worker = [&]() {
+		for (size_t i = next++; i < positions.size(); i = next++) {
+			auto v = Test::GetElements(positions[i], ';');
+			std::string fen = v[0];
+			for (size_t e = 1; e < v.size(); e++) {
+				auto perftvals = Test::GetElements(v[e], ' ');
+				perftvals.erase(std::remove(perftvals.begin(), perftvals.end(), ""), perftvals.end());
+				if (perftvals.size() < 2 || perftvals[0].size() < 2 || perftvals[0][0] != 'D') continue;
+
+				int depth = static_cast<int>(std::strtol(perftvals[0].c_str() + 1, NULL, 10));
+				if (depth > maxdepth) continue;
+				uint64_t expected = static_cast<uint64_t>(std::strtoull(perftvals[1].c_str(), NULL, 10));
+
+				auto start = std::chrono::steady_clock::now();
+				PerfT_Run(fen, depth);
+				auto end = std::chrono::steady_clock::now();
+				results[i].push_back({ depth, expected, MoveReciever::nodes, std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() });
+			}
+		}
+	};
+
+	auto ts = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (int i = 1; i < workers; i++) pool.emplace_back(worker);
+	worker();
+	for (auto& thread : pool) thread.join();
+	auto te = std::chrono::steady_clock::now();
+
+	int failed = 0;
+	uint64_t total = 0;
+	std::cout << "position,depth,expected,nodes,ms,mnps,status\n";
+	for (size_t i = 0; i < positions.size(); i++) {
+		for (const PerftResult& r : results[i]) {
+			const bool ok = r.nodes == r.expected;
+			failed += !ok;
+			total += r.nodes;
+			std::cout << i + 1 << "," << r.depth << "," << r.expected << "," << r.nodes << "," << r.us / 1000 << ","
+				<< r.nodes * 1.0 / std::max(1ll, r.us) << "," << (ok ? "OK" : "ERROR") << "\n";
+		}
+	}
+	long long us = std::chrono::duration_cast<std::chrono::microseconds>(te - ts).count();
+	std::cout << "# positions: " << positions.size() << " nodes: " << total << " " << us / 1000 << "ms " 
+		<< total * 1.0 / std::max(1ll, us) << " MNodes/s failed: " << failed << "\n";
+	return failed;
+}
+
 const auto _keep0 = _map(0);
 const auto _keep1 = _map(0,0);
 const auto _keep2 = _map(0,0,0);
@@ -264,24 +543,52 @@ const auto _keep4 = _map(0, 0, Board::Default(), Board::Default());
 int main(int argc, char** argv)
 {
 	std::vector<std::string> args(argv, argv + argc);
+
+	//Optional thread count for perft: -t 1 counts on a single core
+	//Optional perft hash table in MB: -hash 1024 caches subtree counts
+	//Optional -runtime counts with the runtime depth path
+	for (size_t i = 1; i < args.size();) {
+		if (args[i] == "-t" && i + 1 < args.size()) {
+			Threads = std::max(1, static_cast<int>(std::strtol(args[i + 1].c_str(), NULL, 10)));
+			args.erase(args.begin() + i, args.begin() + i + 2);
+		}
+		else if (args[i] == "-hash" && i + 1 < args.size()) {
+			PerftTT::Resize(static_cast<uint64_t>(std::strtoll(args[i + 1].c_str(), NULL, 10)));
+			args.erase(args.begin() + i, args.begin() + i + 2);
+		}
+		else if (args[i] == "-runtime") {
+			RuntimeDepth = true;
+			args.erase(args.begin() + i);
+		}
+		else i++;
+	}
+
+	//Batch mode for unattended regression runs: -epd perftsuite.epd [maxdepth] - exits with 9 on any mismatch
+	if (args.size() >= 3 && args[1] == "-epd") {
+		std::vector<std::string> positions = Test::ReadEPD(args[2]);
+		if (positions.empty()) { std::cout << "Cannot read " << args[2] << "\n"; return 2; }
+		int maxdepth = args.size() >= 4 ? static_cast<int>(std::strtol(args[3].c_str(), NULL, 10)) : 18;
+		return PerfT_Suite(positions, maxdepth) == 0 ? 0 : 9;
+	}
+
 	if (args.size() >= 4) {
-		std::string_view def(argv[1]);
+		std::string_view def(args[1]);
 		uint64_t depth = static_cast<uint64_t>(std::strtol(args[2].c_str(), NULL, 10));
 		uint64_t exptected = static_cast<uint64_t>(std::strtol(args[3].c_str(), NULL, 10));
 
-		_PerfT(def, static_cast<int>(depth));
+		PerfT_Run(def, static_cast<int>(depth));
 		if (exptected == MoveReciever::nodes) return 0;
 		return 9;
 	}
 	if (args.size() == 3) {
-		std::string_view def(argv[1]);
+		std::string_view def(args[1]);
 		uint64_t depth = static_cast<uint64_t>(std::strtol(args[2].c_str(), NULL, 10));
-		if (depth > 12) { std::cout << "Max depth limited to 12 for now!\n"; return 0; }
-		std::cout << "Depth: " << depth << " - " << def << "\n";
+		if (depth > 12 && !RuntimeDepth) { std::cout << "Max depth limited to 12 for now - use -runtime for deeper perft!\n"; return 0; }
+		std::cout << "Depth: " << depth << " - " << def << " - Threads: " << Threads << "\n";
 		for (int i = 1; i <= depth; i++)
 		{
 			auto start = std::chrono::steady_clock::now();
-			_PerfT(def, i);
+			PerfT_Run(def, i);
 			auto end = std::chrono::steady_clock::now();
 			long long delta = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
 			std::cout << "Perft " << i << ": " << MoveReciever::nodes << " " << delta / 1000 << "ms " << MoveReciever::nodes * 1.0 / delta << " MNodes/s\n";
@@ -308,11 +615,12 @@ int main(int argc, char** argv)
 	std::string_view endgame = "5nk1/pp3pp1/2p4p/q7/2PPB2P/P5P1/1P5K/3Q4 w - - 1 28";
 	//55.8
 
+	std::cout << "Threads: " << Threads << "\n";
 	auto ts = std::chrono::steady_clock::now();
 	for (int i = 1; i <= 7; i++)
 	{
 		auto start = std::chrono::steady_clock::now();
-		_PerfT(def, i);
+		PerfT_Run(def, i);
 		auto end = std::chrono::steady_clock::now();
 		long long delta = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
 		std::cout << "Perft Start " <<i<< ": "<< MoveReciever::nodes << " " << delta / 1000 <<"ms " << MoveReciever::nodes * 1.0 / delta << " MNodes/s\n";
@@ -323,7 +631,7 @@ int main(int argc, char** argv)
 	for (int i = 1; i <= 6; i++)
 	{
 		auto start = std::chrono::steady_clock::now();
-		_PerfT(kiwi, i);
+		PerfT_Run(kiwi, i);
 		auto end = std::chrono::steady_clock::now();
 		long long delta = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
 		std::cout << "Perft Kiwi " << i << ": " << MoveReciever::nodes << " " << delta / 1000 << "ms " << MoveReciever::nodes * 1.0 / delta << " MNodes/s\n";
@@ -334,7 +642,7 @@ int main(int argc, char** argv)
 	for (int i = 1; i <= 6; i++)
 	{
 		auto start = std::chrono::steady_clock::now();
-		_PerfT(midgame, i);
+		PerfT_Run(midgame, i);
 		auto end = std::chrono::steady_clock::now();
 		long long delta = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
 		std::cout << "Perft Midgame " << i << ": " << MoveReciever::nodes << " " << delta / 1000 << "ms " << MoveReciever::nodes * 1.0 / delta << " MNodes/s\n";
@@ -345,7 +653,7 @@ int main(int argc, char** argv)
 	for (int i = 1; i <= 6; i++)
 	{
 		auto start = std::chrono::steady_clock::now();
-		_PerfT(endgame, i);
+		PerfT_Run(endgame, i);
 		auto end = std::chrono::steady_clock::now();
 		long long delta = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
 		std::cout << "Perft Endgame " << i << ": " << MoveReciever::nodes << " " << delta / 1000 << "ms " << MoveReciever::nodes * 1.0 / delta << " MNodes/s\n";
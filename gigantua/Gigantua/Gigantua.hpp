@@ -0,0 +1,292 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "Movelist.hpp"
+
+/// <summary>
+/// Header only library entry point for the Gigantua move generator.
+///
+/// A Visitor is a class with a single static callback that sees every legal move of a position together with the next Board:
+///
+///   struct MyVisitor {
+///       template<class BoardStatus status, int depth>
+///       static void Visit(const Board& brd, Board& next, Gigantua::Move move) {
+///           if constexpr (depth > 0) Gigantua::Enumerate<status, MyVisitor, depth>(next); //Recursion into the next position
+///       }
+///   };
+///   Gigantua::Enumerate<MyVisitor, 4>("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+///
+/// status is the compile time BoardStatus of next and depth is the remaining depth of next.
+/// Enumerate must only be called with depth >= 1 and only from inside Visit (or from a root entry point) because the movestack
+/// of the current thread holds the check and EP information of next only during the callback. Max depth is 31.
+///
+/// Runtime depth: EnumerateRuntime / Expand instantiate the generator for a single movestack depth per BoardStatus.
+/// Visit is then always called with depth == 1 and the visitor keeps track of its own depth - no depth limit and a much smaller binary.
+/// </summary>
+namespace Gigantua
+{
+    enum class MoveType : uint8_t {
+        Quiet, Capture, DoublePush, EnPassant, Castle, Promotion, PromotionCapture
+    };
+
+    /// <summary>
+    /// Squares are bit indices of the Board: h1 = 0, a1 = 7, h8 = 56, a8 = 63
+    /// Castling is encoded as the king move (e1g1) like UCI expects it
+    /// </summary>
+    struct Move {
+        uint8_t from;
+        uint8_t to;
+        BoardPiece piece;
+        BoardPiece promotion; //Only valid for MoveType::Promotion and MoveType::PromotionCapture
+        MoveType type;
+
+        constexpr bool IsCapture() const {
+            return type == MoveType::Capture || type == MoveType::EnPassant || type == MoveType::PromotionCapture;
+        }
+
+        constexpr bool IsPromotion() const {
+            return type == MoveType::Promotion || type == MoveType::PromotionCapture;
+        }
+
+        static std::string SquareName(uint8_t sq) {
+            return { static_cast<char>('a' + (7 - (sq & 7))), static_cast<char>('1' + (sq >> 3)) };
+        }
+
+        std::string uci() const {
+            std::string str = SquareName(from) + SquareName(to);
+            if (IsPromotion()) {
+                switch (promotion) {
+                    case BoardPiece::Queen:  str += 'q'; break;
+                    case BoardPiece::Rook:   str += 'r'; break;
+                    case BoardPiece::Bishop: str += 'b'; break;
+                    case BoardPiece::Knight: str += 'n'; break;
+                    default: break;
+                }
+            }
+            return str;
+        }
+    };
+
+    _Compiletime Move MakeMove(BoardPiece piece, uint64_t from, uint64_t to, MoveType type, BoardPiece promotion = BoardPiece::Pawn) {
+        return Move{ static_cast<uint8_t>(SquareOf(from)), static_cast<uint8_t>(SquareOf(to)), piece, promotion, type };
+    }
+
+    /// <summary>
+    /// Reciever for Movelist::EnumerateMoves that keeps the movestack up to date like the perft reciever
+    /// and hands every move to Visitor::Visit
+    /// </summary>
+    template<class Visitor>
+    class VisitorReciever
+    {
+        template<bool IsWhite>
+        static _ForceInline MoveType Type(const Board& brd, uint64_t to) {
+            return (to & Enemy<IsWhite>(brd)) ? MoveType::Capture : MoveType::Quiet;
+        }
+
+        template<bool IsWhite>
+        static _ForceInline MoveType PromoteType(const Board& brd, uint64_t to) {
+            return (to & Enemy<IsWhite>(brd)) ? MoveType::PromotionCapture : MoveType::Promotion;
+        }
+
+    public:
+        template<class BoardStatus status, int depth>
+        static _Inline void Kingmove(const Board& brd, uint64_t from, uint64_t to)
+        {
+            Board next = Board::Move<BoardPiece::King, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+            Visitor::template Visit<status.KingMove(), depth - 1>(brd, next, MakeMove(BoardPiece::King, from, to, Type<status.WhiteMove>(brd, to)));
+        }
+
+        template<class BoardStatus status, int depth>
+        static _Inline void KingCastle(const Board& brd, uint64_t kingswitch, uint64_t rookswitch)
+        {
+            Board next = Board::MoveCastle<status.WhiteMove>(brd, kingswitch, rookswitch);
+            const Bit king = King<status.WhiteMove>(brd);
+            Visitor::template Visit<status.KingMove(), depth - 1>(brd, next, MakeMove(BoardPiece::King, king, kingswitch ^ king, MoveType::Castle));
+        }
+
+        template<class BoardStatus status, int depth>
+        static _Inline void Pawnmove(const Board& brd, uint64_t from, uint64_t to)
+        {
+            Board next = Board::Move<BoardPiece::Pawn, status.WhiteMove, false>(brd, from, to);
+            Movelist::PawnCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
+            Visitor::template Visit<status.SilentMove(), depth - 1>(brd, next, MakeMove(BoardPiece::Pawn, from, to, MoveType::Quiet));
+            Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
+        }
+
+        template<class BoardStatus status, int depth>
+        static _Inline void Pawnatk(const Board& brd, uint64_t from, uint64_t to)
+        {
+            Board next = Board::Move<BoardPiece::Pawn, status.WhiteMove, true>(brd, from, to);
+            Movelist::PawnCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
+            Visitor::template Visit<status.SilentMove(), depth - 1>(brd, next, MakeMove(BoardPiece::Pawn, from, to, MoveType::Capture));
+            Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
+        }
+
+        template<class BoardStatus status, int depth>
+        static _Inline void PawnEnpassantTake(const Board& brd, uint64_t from, uint64_t enemy, uint64_t to)
+        {
+            Board next = Board::MoveEP<status.WhiteMove>(brd, from, enemy, to);
+            Movelist::PawnCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
+            Visitor::template Visit<status.SilentMove(), depth - 1>(brd, next, MakeMove(BoardPiece::Pawn, from, to, MoveType::EnPassant));
+            Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
+        }
+
+        template<class BoardStatus status, int depth>
+        static _Inline void Pawnpush(const Board& brd, uint64_t from, uint64_t to)
+        {
+            Board next = Board::Move<BoardPiece::Pawn, status.WhiteMove, false>(brd, from, to);
+            Movelist::EnPassantTarget = to;
+            Movelist::PawnCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
+            Visitor::template Visit<status.PawnPush(), depth - 1>(brd, next, MakeMove(BoardPiece::Pawn, from, to, MoveType::DoublePush));
+            Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
+        }
+
+        template<class BoardStatus status, int depth>
+        static _Inline void Pawnpromote(const Board& brd, uint64_t from, uint64_t to)
+        {
+            const MoveType type = PromoteType<status.WhiteMove>(brd, to);
+
+            Board next1 = Board::MovePromote<BoardPiece::Queen, status.WhiteMove>(brd, from, to);
+            Visitor::template Visit<status.SilentMove(), depth - 1>(brd, next1, MakeMove(BoardPiece::Pawn, from, to, type, BoardPiece::Queen));
+
+            Board next2 = Board::MovePromote<BoardPiece::Knight, status.WhiteMove>(brd, from, to);
+            Movelist::KnightCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
+            Visitor::template Visit<status.SilentMove(), depth - 1>(brd, next2, MakeMove(BoardPiece::Pawn, from, to, type, BoardPiece::Knight));
+            Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
+
+            Board next3 = Board::MovePromote<BoardPiece::Bishop, status.WhiteMove>(brd, from, to);
+            Visitor::template Visit<status.SilentMove(), depth - 1>(brd, next3, MakeMove(BoardPiece::Pawn, from, to, type, BoardPiece::Bishop));
+            Board next4 = Board::MovePromote<BoardPiece::Rook, status.WhiteMove>(brd, from, to);
+            Visitor::template Visit<status.SilentMove(), depth - 1>(brd, next4, MakeMove(BoardPiece::Pawn, from, to, type, BoardPiece::Rook));
+        }
+
+        template<class BoardStatus status, int depth>
+        static _Inline void Knightmove(const Board& brd, uint64_t from, uint64_t to)
+        {
+            Board next = Board::Move<BoardPiece::Knight, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+            Movelist::KnightCheck<status, depth>(EnemyKing<status.WhiteMove>(brd), to);
+            Visitor::template Visit<status.SilentMove(), depth - 1>(brd, next, MakeMove(BoardPiece::Knight, from, to, Type<status.WhiteMove>(brd, to)));
+            Movestack::Check_Status[depth - 1] = 0xffffffffffffffffull;
+        }
+
+        template<class BoardStatus status, int depth>
+        static _Inline void Bishopmove(const Board& brd, uint64_t from, uint64_t to)
+        {
+            Board next = Board::Move<BoardPiece::Bishop, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+            Visitor::template Visit<status.SilentMove(), depth - 1>(brd, next, MakeMove(BoardPiece::Bishop, from, to, Type<status.WhiteMove>(brd, to)));
+        }
+
+        template<class BoardStatus status, int depth>
+        static _Inline void Rookmove(const Board& brd, uint64_t from, uint64_t to)
+        {
+            Board next = Board::Move<BoardPiece::Rook, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+            const Move move = MakeMove(BoardPiece::Rook, from, to, Type<status.WhiteMove>(brd, to));
+            if constexpr (status.CanCastle()) {
+                if (status.IsLeftRook(from)) Visitor::template Visit<status.RookMove_Left(), depth - 1>(brd, next, move);
+                else if (status.IsRightRook(from)) Visitor::template Visit<status.RookMove_Right(), depth - 1>(brd, next, move);
+                else Visitor::template Visit<status.SilentMove(), depth - 1>(brd, next, move);
+            }
+            else Visitor::template Visit<status.SilentMove(), depth - 1>(brd, next, move);
+        }
+
+        template<class BoardStatus status, int depth>
+        static _Inline void Queenmove(const Board& brd, uint64_t from, uint64_t to)
+        {
+            Board next = Board::Move<BoardPiece::Queen, status.WhiteMove>(brd, from, to, to & Enemy<status.WhiteMove>(brd));
+            Visitor::template Visit<status.SilentMove(), depth - 1>(brd, next, MakeMove(BoardPiece::Queen, from, to, Type<status.WhiteMove>(brd, to)));
+        }
+    };
+
+    /// <summary>
+    /// Calls Visitor::Visit for every legal move of brd. depth is the remaining depth of brd and must be >= 1
+    /// </summary>
+    template<class BoardStatus status, class Visitor, int depth>
+    _Inline void Enumerate(Board& brd)
+    {
+        static_assert(depth >= 1 && depth < 32, "Enumerate needs 1 <= depth < 32 - the movestack has 32 entries");
+        Movelist::EnumerateMoves<status, VisitorReciever<Visitor>, depth>(brd);
+    }
+
+    /// <summary>
+    /// Number of legal moves of brd without calling the visitor - only valid at depth 1 (leaf nodes)
+    /// </summary>
+    template<class BoardStatus status, int depth>
+    _Inline uint64_t Count(Board& brd)
+    {
+        static_assert(depth == 1, "Count reads the movestack entry of depth 1");
+        return Movelist::count<status>(brd);
+    }
+
+    /// <summary>
+    /// Runtime depth version of Enumerate - call from Visit with the next board. 
+    /// Only movestack entries 1 and 2 are used: the entry of next is moved up to 2 for the recursion and both are restored afterwards
+    /// </summary>
+    template<class BoardStatus status, class Visitor>
+    _Inline void Expand(Board& next)
+    {
+        const map atk1 = Movestack::Atk_King[1], eatk1 = Movestack::Atk_EKing[1], check1 = Movestack::Check_Status[1];
+        const map atk2 = Movestack::Atk_King[2], eatk2 = Movestack::Atk_EKing[2], check2 = Movestack::Check_Status[2];
+        Movestack::Atk_King[2] = atk1; Movestack::Atk_EKing[2] = eatk1; Movestack::Check_Status[2] = check1;
+
+        Movelist::EnumerateMoves<status, VisitorReciever<Visitor>, 2>(next);
+
+        Movestack::Atk_King[1] = atk1; Movestack::Atk_EKing[1] = eatk1; Movestack::Check_Status[1] = check1;
+        Movestack::Atk_King[2] = atk2; Movestack::Atk_EKing[2] = eatk2; Movestack::Check_Status[2] = check2;
+    }
+
+    /// <summary>
+    /// BoardStatus pattern of a FEN as used by BoardStatus(int): 0b[white][ep][wcastleL][wcastleR][bcastleL][bcastleR]
+    /// </summary>
+    inline int StatusPattern(std::string_view fen)
+    {
+        return (FEN::FenInfo<FenField::white>(fen)    ? 0b100000 : 0) |
+               (FEN::FenInfo<FenField::hasEP>(fen)    ? 0b010000 : 0) |
+               (FEN::FenInfo<FenField::WCastleL>(fen) ? 0b001000 : 0) |
+               (FEN::FenInfo<FenField::WCastleR>(fen) ? 0b000100 : 0) |
+               (FEN::FenInfo<FenField::BCastleL>(fen) ? 0b000010 : 0) |
+               (FEN::FenInfo<FenField::BCastleR>(fen) ? 0b000001 : 0);
+    }
+
+    /// <summary>
+    /// Calls func.template operator()<BoardStatus>() with the compile time BoardStatus of a runtime pattern
+    /// Use with a templated lambda: []<BoardStatus status>() { ... }
+    /// </summary>
+    template<int pattern = 0, class Func>
+    _Inline auto Dispatch(int status, Func&& func)
+    {
+        if constexpr (pattern < 63) {
+            if (status != pattern) return Dispatch<pattern + 1>(status, std::forward<Func>(func));
+        }
+        return func.template operator()<BoardStatus(pattern)>();
+    }
+
+    /// <summary>
+    /// Runtime position entry point - parses the FEN, sets up the movestack of the current thread and enumerates the root
+    /// </summary>
+    template<class Visitor, int depth>
+    void Enumerate(std::string_view fen)
+    {
+        Board brd(fen);
+        Movelist::Init(FEN::FenEnpassant(fen));
+        Dispatch(StatusPattern(fen), [&]<BoardStatus status>() {
+            Movelist::InitStack<status, depth>(brd);
+            Enumerate<status, Visitor, depth>(brd);
+        });
+    }
+
+    /// <summary>
+    /// Runtime depth entry point - Visit is called with depth == 1 for every move and Expand continues the recursion
+    /// </summary>
+    template<class Visitor>
+    void EnumerateRuntime(std::string_view fen)
+    {
+        Board brd(fen);
+        Movelist::Init(FEN::FenEnpassant(fen));
+        Dispatch(StatusPattern(fen), [&]<BoardStatus status>() {
+            Movelist::InitStack<status, 2>(brd);
+            Movelist::EnumerateMoves<status, VisitorReciever<Visitor>, 2>(brd);
+        });
+    }
+}
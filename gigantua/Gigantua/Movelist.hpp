@@ -4,23 +4,26 @@
 
 
 
+//Movestack and Movelist state is thread_local so every thread can enumerate its own tree (threaded perft)
 namespace Movestack 
 {
     //Can be removed - incremental bitboard to save some slider lookups is more expensive then lookup itself. So this release does not have a changemap
-    static inline Square Atk_King[32];  //Current moves for current King
-    static inline Square Atk_EKing[32]; //Current enemy king attacked squares
+    static inline thread_local Square Atk_King[32];  //Current moves for current King
+    static inline thread_local Square Atk_EKing[32]; //Current enemy king attacked squares
 
-    static inline map Check_Status[32];   //When a pawn or a knight does check we can assume at least one check. And only one (initially) since a pawn or knight cannot do discovery
+    static inline thread_local map Check_Status[32];   //When a pawn or a knight does check we can assume at least one check. And only one (initially) since a pawn or knight cannot do discovery
+
+    static inline thread_local uint64_t Hash[32];    //Zobrist key of the pieces - only maintained by recievers that use a hash table
 }
 
 
 namespace Movelist {
     //move = atkmap + enemyorempty + checkmask + pins 
-    map EnPassantTarget = { }; //Where the current EP Target is. Only valid if the movestatus contains EP flag. 
+    inline thread_local map EnPassantTarget = { }; //Where the current EP Target is. Only valid if the movestatus contains EP flag. 
 
     //These fields change during enumeration - so we have to copy them to a local variable!
-    map RookPin = { }; //Pins that run in rank or file direction - important because a queen can see two pins at once: https://lichess.org/editor?fen=3r4%2F8%2F8%2F3P4%2F3K1Q1r%2F8%2F8%2F8+w+-+-+0+1
-    map BishopPin = { }; //Pins that run in diagonal direction
+    inline thread_local map RookPin = { }; //Pins that run in rank or file direction - important because a queen can see two pins at once: https://lichess.org/editor?fen=3r4%2F8%2F8%2F3P4%2F3K1Q1r%2F8%2F8%2F8+w+-+-+0+1
+    inline thread_local map BishopPin = { }; //Pins that run in diagonal direction
 
 
     template<class BoardStatus status, int depth>
@@ -59,6 +62,21 @@ namespace Movelist {
         Movelist::EnPassantTarget = EPInit; //EPSuare is not a member of the template
     }
 
+    //A pawn or knight that lands next to the enemy king gives check - stored for the next position. Every reciever has to reset Check_Status[depth - 1] after the move
+    template<class BoardStatus status, int depth>
+    _ForceInline void PawnCheck(map eking, uint64_t to) {
+        constexpr bool white = status.WhiteMove;
+        map pl = Pawn_AttackLeft<white>(to & Pawns_NotLeft());
+        map pr = Pawn_AttackRight<white>(to & Pawns_NotRight());
+
+        if (eking & (pl | pr)) Movestack::Check_Status[depth - 1] = to;
+    }
+
+    template<class BoardStatus status, int depth>
+    _ForceInline void KnightCheck(map eking, uint64_t to) {
+        if (Lookup::Knight(SquareOf(eking)) & to) Movestack::Check_Status[depth - 1] = to;
+    }
+
 
     //PinHVD1D2 |= Path from Enemy to excluding King + enemy. Has Seemap from king as input
     //Must have enemy slider AND own piece or - VERY special: can clear enemy enpassant pawn
@@ -3517,6 +3517,7 @@ typedef struct {
     int depth;      // current search depth
     int flag;       // flag the type of node (fail-low/fail-high/PV) 
     int score;      // score (alpha/beta/PV)
+    int best_move;  // best move found in the position (0 if none)
 } tt;               // transposition table (TT aka hash table)
 
 // define TT instance
@@ -3536,6 +3537,7 @@ void clear_hash_table()
         hash_entry->depth = 0;
         hash_entry->flag = 0;
         hash_entry->score = 0;
+        hash_entry->best_move = 0;
     }
 }
 
@@ -3582,7 +3584,7 @@ void init_hash_table(int mb)
 }
 
 // read hash entry data
-static inline int read_hash_entry(int alpha, int beta, int depth)
+static inline int read_hash_entry(int alpha, int beta, int *best_move, int depth)
 {
     // create a TT instance pointer to particular hash entry storing
     // the scoring data for the current board position if available
@@ -3591,6 +3593,9 @@ static inline int read_hash_entry(int alpha, int beta, int depth)
     // make sure we're dealing with the exact position we need
     if (hash_entry->hash_key == hash_key)
     {
+        // hash move is useful for move ordering even if the depth is too shallow
+        *best_move = hash_entry->best_move;
+        
         // make sure that we match the exact depth our search is now at
         if (hash_entry->depth >= depth)
         {
@@ -3626,7 +3631,7 @@ static inline int read_hash_entry(int alpha, int beta, int depth)
 }
 
 // write hash entry data
-static inline void write_hash_entry(int score, int depth, int hash_flag)
+static inline void write_hash_entry(int score, int best_move, int depth, int hash_flag)
 {
     // create a TT instance pointer to particular hash entry storing
     // the scoring data for the current board position if available
@@ -3642,6 +3647,7 @@ static inline void write_hash_entry(int score, int depth, int hash_flag)
     hash_entry->score = score;
     hash_entry->flag = hash_flag;
     hash_entry->depth = depth;
+    hash_entry->best_move = best_move;
 }
 
 // enable PV move scoring
@@ -3669,12 +3675,13 @@ static inline void enable_pv_scoring(moves *move_list)
          Move ordering
     =======================
     
-    1. PV move
-    2. Captures in MVV/LVA
-    3. 1st killer move
-    4. 2nd killer move
-    5. History moves
-    6. Unsorted moves
+    1. Hash move
+    2. PV move
+    3. Captures in MVV/LVA
+    4. 1st killer move
+    5. 2nd killer move
+    6. History moves
+    7. Unsorted moves
 */
 
 // score moves
@@ -3743,15 +3750,22 @@ static inline int score_move(int move)
 }
 
 // sort moves in descending order
-static inline int sort_moves(moves *move_list)
+static inline int sort_moves(moves *move_list, int best_move)
 {
     // move scores
     int move_scores[move_list->count];
     
     // score all the moves within a move list
     for (int count = 0; count < move_list->count; count++)
+    {
         // score move
         move_scores[count] = score_move(move_list->moves[count]);
+        
+        // if hash move is available
+        if (best_move == move_list->moves[count])
+            // give hash move the highest score to search it first
+            move_scores[count] = 30000;
+    }
     
     // loop over current move within a move list
     for (int current_move = 0; current_move < move_list->count; current_move++)
@@ -3819,6 +3833,12 @@ static inline int quiescence(int alpha, int beta)
     if (ply > max_ply - 1)
         // evaluate position
         return evaluate();
+    
+    // best move (to store in TT)
+    int best_move = 0;
+    
+    // read hash move left by a deeper search of this position
+    read_hash_entry(alpha, beta, &best_move, 0);
 
     // evaluate position
     int evaluation = evaluate();
@@ -3844,7 +3864,7 @@ static inline int quiescence(int alpha, int beta)
     generate_moves(move_list);
     
     // sort moves
-    sort_moves(move_list);
+    sort_moves(move_list, best_move);
     
     // loop over moves within a movelist
     for (int count = 0; count < move_list->count; count++)
@@ -3922,6 +3942,9 @@ static inline int negamax(int alpha, int beta, int depth)
     // define hash flag
     int hash_flag = hash_flag_alpha;
     
+    // best move (to store in TT)
+    int best_move = 0;
+    
     // if position repetition occurs
     if (ply && is_repetition())
         // return draw score
@@ -3930,9 +3953,12 @@ static inline int negamax(int alpha, int beta, int depth)
     // a hack by Pedro Castro to figure out whether the current node is PV node or not 
     int pv_node = beta - alpha > 1;
     
-    // read hash entry if we're not in a root ply and hash entry is available
+    // read hash entry (it also picks up the hash move for move ordering)
+    score = read_hash_entry(alpha, beta, &best_move, depth);
+    
+    // if we're not in a root ply and hash entry is available
     // and current node is not a PV node
-    if (ply && (score = read_hash_entry(alpha, beta, depth)) != no_hash_entry && pv_node == 0)
+    if (ply && score != no_hash_entry && pv_node == 0)
         // if the move has already been searched (hence has a value)
         // we just return the score for this move without searching it
         return score;
@@ -4029,7 +4055,7 @@ static inline int negamax(int alpha, int beta, int depth)
         enable_pv_scoring(move_list);
     
     // sort moves
-    sort_moves(move_list);
+    sort_moves(move_list, best_move);
     
     // number of moves searched in a move list
     int moves_searched = 0;
@@ -4127,6 +4153,9 @@ static inline int negamax(int alpha, int beta, int depth)
             // switch hash flag from storing score for fail-low node
             // to the one storing score for PV node
             hash_flag = hash_flag_exact;
+            
+            // store best move (for TT)
+            best_move = move_list->moves[count];
         
             // on quiet moves
             if (get_move_capture(move_list->moves[count]) == 0)
@@ -4151,7 +4180,7 @@ static inline int negamax(int alpha, int beta, int depth)
             if (score >= beta)
             {
                 // store hash entry with the score equal to beta
-                write_hash_entry(beta, depth, hash_flag_beta);
+                write_hash_entry(beta, best_move, depth, hash_flag_beta);
             
                 // on quiet moves
                 if (get_move_capture(move_list->moves[count]) == 0)
@@ -4182,7 +4211,7 @@ static inline int negamax(int alpha, int beta, int depth)
     }
     
     // store hash entry with the score equal to alpha
-    write_hash_entry(alpha, depth, hash_flag);
+    write_hash_entry(alpha, best_move, depth, hash_flag);
     
     // node (position) fails low
     return alpha;
@@ -86,15 +86,25 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #ifdef WIN64
     #include <windows.h>
 #else
-    # include <sys/time.h>
+    # include <time.h>
+#endif
+
+// BMI2 build variant (make bmi2) indexes slider attack tables with PEXT
+#ifdef USE_PEXT
+    #include <immintrin.h>
 #endif
 
 // include NNUE wrapper header
 #include "nnue_eval.h"
 
+// include Syzygy tablebase prober header
+#include "./syzygy/tbprobe.h"
+
 // define version
 #define version "1.2"
 
@@ -301,32 +311,52 @@ char promoted_pieces[] = {
 
 */
 
+/*
+    Board state and search data are thread local (__thread), so
+    every Lazy SMP search thread works on its own copy of them
+*/
+
 // piece bitboards
-U64 bitboards[12];
+__thread U64 bitboards[12];
 
 // occupancy bitboards
-U64 occupancies[3];
+__thread U64 occupancies[3];
 
 // side to move
-int side;
+__thread int side;
 
 // enpassant square
-int enpassant = no_sq; 
+__thread int enpassant = no_sq; 
 
 // castling rights
-int castle;
+__thread int castle;
+
+// fifty move rule counter (half moves since the last capture or pawn move)
+__thread int fifty;
 
 // "almost" unique position identifier aka hash key or position key
-U64 hash_key;
+__thread U64 hash_key;
+
+// pawn structure identifier aka pawn hash key
+__thread U64 pawn_key;
 
 // positions repetition table
-U64 repetition_table[1000];  // 1000 is a number of plies (500 moves) in the entire game
+__thread U64 repetition_table[1000];  // 1000 is a number of plies (500 moves) in the entire game
 
 // repetition index
-int repetition_index;
+__thread int repetition_index;
 
 // half move counter
-int ply;
+__thread int ply;
+
+// search thread index (0 is the main thread talking to GUI)
+__thread int thread_id = 0;
+
+// max ply that we can reach within a search
+#define max_ply 64
+
+// NNUE accumulators & pieces changed by the move leading to the position [ply]
+__thread NNUEdata nnue_stack[max_ply + 1];
 
 
 /**********************************\
@@ -337,8 +367,8 @@ int ply;
  ==================================
 \**********************************/
 
-// exit from engine flag
-int quit = 0;
+// exit from engine flag (set by the UCI input thread)
+atomic_int quit = 0;
 
 // UCI "movestogo" command moves counter
 int movestogo = 30;
@@ -347,7 +377,7 @@ int movestogo = 30;
 int movetime = -1;
 
 // UCI "time" command holder (ms)
-int time = -1;
+int uci_time = -1;
 
 // UCI "inc" command's time increment holder
 int inc = 0;
@@ -355,14 +385,41 @@ int inc = 0;
 // UCI "starttime" command time holder
 int starttime = 0;
 
-// UCI "stoptime" command time holder
-int stoptime = 0;
+// UCI "stoptime" command time holder (per thread, EPD jobs keep their own)
+__thread int stoptime = 0;
+
+// variable to flag time control availability (per thread, EPD jobs keep their own)
+__thread int timeset = 0;
+
+// time to think for when the search goes as expected (-1 disables time management)
+__thread int optimum_time = -1;
+
+// variable to flag when the time is up (read by all the search threads)
+atomic_int stopped = 0;
 
-// variable to flag time control availability
-int timeset = 0;
+// flag the current thread stops on (EPD jobs point it to their own flag)
+__thread atomic_int *stop_flag = &stopped;
 
-// variable to flag when the time is up
-int stopped = 0;
+// variable to flag the search is running (UCI input thread handles "stop" itself)
+atomic_int searching = 0;
+
+// variable to flag the search must not stop on its own ("go infinite" & "go ponder")
+atomic_int infinite = 0;
+
+// variable to flag "ponderhit" has arrived (set by the UCI input thread)
+atomic_int ponderhit = 0;
+
+// variable to flag the search is pondering (main thread starts its clock on "ponderhit")
+int pondering = 0;
+
+// time to think for after "ponderhit" (-1 if there's no time control)
+int ponder_time = -1;
+
+// variable to flag search info output is suppressed (bench)
+int quiet_search = 0;
+
+// best move found by the last search
+int last_best_move = 0;
 
 
 /**********************************\
@@ -375,129 +432,153 @@ int stopped = 0;
  ==================================
 \**********************************/
 
-// get time in milliseconds
+// get time in milliseconds (monotonic clock, cheap enough to be read during search)
 int get_time_ms()
 {
     #ifdef WIN64
         return GetTickCount();
     #else
-        struct timeval time_value;
-        gettimeofday(&time_value, NULL);
-        return time_value.tv_sec * 1000 + time_value.tv_usec / 1000;
+        struct timespec time_value;
+        clock_gettime(CLOCK_MONOTONIC, &time_value);
+        return time_value.tv_sec * 1000 + time_value.tv_nsec / 1000000;
     #endif
 }
 
 /*
 
-  Function to "listen" to GUI's input during search.
-  It's waiting for the user input from STDIN.
-  OS dependent.
-  
-  First Richard Allbert aka BluefeverSoftware grabbed it from somewhere...
-  And then Code Monkey King has grabbed it from VICE)
+  UCI input is read by a dedicated thread, so the search never polls STDIN.
+  "stop" and "quit" are handled by the input thread right away by raising
+  atomic flags, all the other commands are queued for the UCI loop.
   
 */
-  
-int input_waiting()
-{
-    #ifndef WIN32
-        fd_set readfds;
-        struct timeval tv;
-        FD_ZERO (&readfds);
-        FD_SET (fileno(stdin), &readfds);
-        tv.tv_sec=0; tv.tv_usec=0;
-        select(16, &readfds, 0, 0, &tv);
-
-        return (FD_ISSET(fileno(stdin), &readfds));
-    #else
-        static int init = 0, pipe;
-        static HANDLE inh;
-        DWORD dw;
 
-        if (!init)
-        {
-            init = 1;
-            inh = GetStdHandle(STD_INPUT_HANDLE);
-            pipe = !GetConsoleMode(inh, &dw);
-            if (!pipe)
-            {
-                SetConsoleMode(inh, dw & ~(ENABLE_MOUSE_INPUT|ENABLE_WINDOW_INPUT));
-                FlushConsoleInputBuffer(inh);
-            }
-        }
-        
-        if (pipe)
-        {
-           if (!PeekNamedPipe(inh, NULL, 0, NULL, &dw, NULL)) return 1;
-           return dw;
-        }
-        
-        else
-        {
-           GetNumberOfConsoleInputEvents(inh, &dw);
-           return dw <= 1 ? 0 : dw;
-        }
+// max number of UCI commands waiting in the input queue
+#define max_input_lines 64
 
-    #endif
+// max length of a single UCI command
+#define max_input_length 2000
+
+// UCI commands read by the input thread waiting for the UCI loop
+char input_queue[max_input_lines][max_input_length];
+
+// input queue read & write indices
+int input_head = 0, input_tail = 0;
+
+// input queue synchronization
+pthread_mutex_t input_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t input_changed = PTHREAD_COND_INITIALIZER;
+
+// put UCI command into the input queue
+void push_input(char *input)
+{
+    pthread_mutex_lock(&input_mutex);
+    
+    // wait for the UCI loop to free some space
+    while (input_tail - input_head == max_input_lines)
+        pthread_cond_wait(&input_changed, &input_mutex);
+    
+    // store command
+    strcpy(input_queue[input_tail % max_input_lines], input);
+    input_tail++;
+    
+    pthread_cond_broadcast(&input_changed);
+    pthread_mutex_unlock(&input_mutex);
 }
 
-// read GUI/user input
-void read_input()
+// get next UCI command from the input queue (waits for the input if needed)
+void pop_input(char *input)
 {
-    // bytes to read holder
-    int bytes;
+    pthread_mutex_lock(&input_mutex);
     
-    // GUI/user input
-    char input[256] = "", *endc;
+    // wait for the input thread to read a command
+    while (input_tail == input_head)
+        pthread_cond_wait(&input_changed, &input_mutex);
+    
+    // copy command
+    strcpy(input, input_queue[input_head % max_input_lines]);
+    input_head++;
+    
+    pthread_cond_broadcast(&input_changed);
+    pthread_mutex_unlock(&input_mutex);
+}
 
-    // "listen" to STDIN
-    if (input_waiting())
+// read GUI/user input
+void *read_input(void *arg)
+{
+    // GUI/user input
+    char input[max_input_length];
+    
+    // read commands until "quit"
+    while (1)
     {
-        // tell engine to stop calculating
-        stopped = 1;
+        // end of input
+        if (!fgets(input, max_input_length, stdin))
+        {
+            // let UCI loop finish queued commands and exit
+            push_input("quit\n");
+            break;
+        }
         
-        // loop to read bytes from STDIN
-        do
+        // match UCI "stop" command
+        if (!strncmp(input, "stop", 4))
         {
-            // read bytes from STDIN
-            bytes=read(fileno(stdin), input, 256);
+            // tell engine to stop calculating
+            stopped = 1;
+            continue;
         }
         
-        // until bytes available
-        while (bytes < 0);
+        // match UCI "quit" command
+        if (!strncmp(input, "quit", 4))
+        {
+            // tell engine to terminate exacution
+            quit = 1;
+            stopped = 1;
+            
+            // let UCI loop exit
+            push_input(input);
+            break;
+        }
         
-        // searches for the first occurrence of '\n'
-        endc = strchr(input,'\n');
+        // GUI may ping the engine while it's thinking
+        if (!strncmp(input, "isready", 7) && searching)
+        {
+            printf("readyok\n");
+            continue;
+        }
         
-        // if found new line set value at pointer to 0
-        if (endc) *endc=0;
+        // opponent has played the move we ponder on
+        if (!strncmp(input, "ponderhit", 9))
+        {
+            // let the search go on as a normal timed search
+            ponderhit = 1;
+            infinite = 0;
+            continue;
+        }
         
-        // if input is available
-        if (strlen(input) > 0)
+        // reset "time is up" & "ponderhit" flags before they can arrive for this search
+        if (!strncmp(input, "go", 2))
         {
-            // match UCI "quit" command
-            if (!strncmp(input, "quit", 4))
-                // tell engine to terminate exacution    
-                quit = 1;
-
-            // // match UCI "stop" command
-            else if (!strncmp(input, "stop", 4))
-                // tell engine to terminate exacution
-                quit = 1;
-        }   
+            stopped = 0;
+            ponderhit = 0;
+        }
+        
+        // queue command for the UCI loop
+        push_input(input);
     }
+    
+    // terminate input thread
+    return NULL;
 }
 
-// a bridge function to interact between search and GUI input
-static void communicate() {
-	// if time is up break here
-    if(timeset == 1 && get_time_ms() > stoptime) {
-		// tell engine to stop calculating
-		stopped = 1;
-	}
-	
-    // read GUI input
-	read_input();
+// start UCI input thread
+void init_input_thread()
+{
+    // input thread handle
+    pthread_t input_thread;
+    
+    // start input thread, it terminates on its own on "quit"
+    pthread_create(&input_thread, NULL, read_input, NULL);
+    pthread_detach(input_thread);
 }
 
 
@@ -546,6 +627,27 @@ U64 get_random_U64_number()
     return n1 | (n2 << 16) | (n3 << 32) | (n4 << 48);
 }
 
+/*
+    Hash keys need their own generator: every 32-bit XOR shift output is a
+    linear function of the 32-bit state, so keys built from it are linearly
+    dependent and XORs of different piece sets collide (perft hash notices)
+*/
+
+// pseudo random hash key state
+U64 hash_key_state = 1804289383ULL;
+
+// generate 64-bit pseudo random hash key (XOR shift star)
+U64 get_random_hash_key()
+{
+    // XOR shift algorithm
+    hash_key_state ^= hash_key_state >> 12;
+    hash_key_state ^= hash_key_state << 25;
+    hash_key_state ^= hash_key_state >> 27;
+    
+    // scramble output to break linearity
+    return hash_key_state * 2685821657736338717ULL;
+}
+
 // generate magic number candidate
 U64 generate_magic_number()
 {
@@ -569,6 +671,11 @@ U64 generate_magic_number()
 // count bits within a bitboard (Brian Kernighan's way)
 static inline int count_bits(U64 bitboard)
 {
+    // use POPCNT instruction if available
+    #ifdef USE_POPCNT
+        return __builtin_popcountll(bitboard);
+    #endif
+    
     // bit counter
     int count = 0;
     
@@ -592,6 +699,11 @@ static inline int get_ls1b_index(U64 bitboard)
     // make sure bitboard is not 0
     if (bitboard)
     {
+        // use TZCNT instruction if available
+        #ifdef USE_POPCNT
+            return __builtin_ctzll(bitboard);
+        #endif
+        
         // count trailing bits before LS1B
         return count_bits((bitboard & -bitboard) - 1);
     }
@@ -626,8 +738,8 @@ U64 side_key;
 // init random hash keys
 void init_random_keys()
 {
-    // update pseudo random number state
-    random_state = 1804289383;
+    // update pseudo random hash key state
+    hash_key_state = 1804289383ULL;
 
     // loop over piece codes
     for (int piece = P; piece <= k; piece++)
@@ -635,21 +747,21 @@ void init_random_keys()
         // loop over board squares
         for (int square = 0; square < 64; square++)
             // init random piece keys
-            piece_keys[piece][square] = get_random_U64_number();
+            piece_keys[piece][square] = get_random_hash_key();
     }
     
     // loop over board squares
     for (int square = 0; square < 64; square++)
         // init random enpassant keys
-        enpassant_keys[square] = get_random_U64_number();
+        enpassant_keys[square] = get_random_hash_key();
     
     // loop over castling keys
     for (int index = 0; index < 16; index++)
         // init castling keys
-        castle_keys[index] = get_random_U64_number();
+        castle_keys[index] = get_random_hash_key();
         
     // init random side key
-    side_key = get_random_U64_number();
+    side_key = get_random_hash_key();
 }
 
 // generate "almost" unique position ID aka hash key from scratch
@@ -696,6 +808,39 @@ U64 generate_hash_key()
     return final_key;
 }
 
+// generate "almost" unique pawn structure identifier
+U64 generate_pawn_key()
+{
+    // final pawn key
+    U64 final_key = 0ULL;
+    
+    // temp pawn bitboard copy
+    U64 bitboard;
+    
+    // loop over pawn bitboards
+    for (int piece = P; piece <= p; piece += p - P)
+    {
+        // init pawn bitboard copy
+        bitboard = bitboards[piece];
+        
+        // loop over the pawns within a bitboard
+        while (bitboard)
+        {
+            // init square occupied by the pawn
+            int square = get_ls1b_index(bitboard);
+            
+            // hash pawn
+            final_key ^= piece_keys[piece][square];
+            
+            // pop LS1B
+            pop_bit(bitboard, square);
+        }
+    }
+    
+    // return generated pawn key
+    return final_key;
+}
+
 
 /**********************************\
  ==================================
@@ -821,6 +966,9 @@ void reset_board()
     
     // reset repetition table
     memset(repetition_table, 0ULL, sizeof(repetition_table));
+    
+    // root NNUE accumulator needs to be refreshed
+    nnue_stack[0].accumulator.computedAccumulation = 0;
 }
 
 // parse FEN string
@@ -931,6 +1079,12 @@ void parse_fen(char *fen)
     else
         enpassant = no_sq;
     
+    // go to parsing half move clock
+    while (*fen && *fen != ' ') fen++;
+    
+    // parse half move clock (missing in some FENs)
+    fifty = (*fen == ' ') ? atoi(fen + 1) : 0;
+    
     // loop over white pieces bitboards
     for (int piece = P; piece <= K; piece++)
         // populate white occupancy bitboard
@@ -947,6 +1101,9 @@ void parse_fen(char *fen)
     
     // init hash key
     hash_key = generate_hash_key();
+    
+    // init pawn key
+    pawn_key = generate_pawn_key();
 }
 
 
@@ -1549,7 +1706,11 @@ void init_sliders_attacks(int bishop)
                 U64 occupancy = set_occupancy(index, relevant_bits_count, attack_mask);
                 
                 // init magic index
-                int magic_index = (occupancy * bishop_magic_numbers[square]) >> (64 - bishop_relevant_bits[square]);
+                #ifdef USE_PEXT
+                    int magic_index = _pext_u64(occupancy, attack_mask);
+                #else
+                    int magic_index = (occupancy * bishop_magic_numbers[square]) >> (64 - bishop_relevant_bits[square]);
+                #endif
                 
                 // init bishop attacks
                 bishop_attacks[square][magic_index] = bishop_attacks_on_the_fly(square, occupancy);
@@ -1562,7 +1723,11 @@ void init_sliders_attacks(int bishop)
                 U64 occupancy = set_occupancy(index, relevant_bits_count, attack_mask);
                 
                 // init magic index
-                int magic_index = (occupancy * rook_magic_numbers[square]) >> (64 - rook_relevant_bits[square]);
+                #ifdef USE_PEXT
+                    int magic_index = _pext_u64(occupancy, attack_mask);
+                #else
+                    int magic_index = (occupancy * rook_magic_numbers[square]) >> (64 - rook_relevant_bits[square]);
+                #endif
                 
                 // init rook attacks
                 rook_attacks[square][magic_index] = rook_attacks_on_the_fly(square, occupancy);
@@ -1576,9 +1741,13 @@ void init_sliders_attacks(int bishop)
 static inline U64 get_bishop_attacks(int square, U64 occupancy)
 {
     // get bishop attacks assuming current board occupancy
-    occupancy &= bishop_masks[square];
-    occupancy *= bishop_magic_numbers[square];
-    occupancy >>= 64 - bishop_relevant_bits[square];
+    #ifdef USE_PEXT
+        occupancy = _pext_u64(occupancy, bishop_masks[square]);
+    #else
+        occupancy &= bishop_masks[square];
+        occupancy *= bishop_magic_numbers[square];
+        occupancy >>= 64 - bishop_relevant_bits[square];
+    #endif
     
     // return bishop attacks
     return bishop_attacks[square][occupancy];
@@ -1588,9 +1757,13 @@ static inline U64 get_bishop_attacks(int square, U64 occupancy)
 static inline U64 get_rook_attacks(int square, U64 occupancy)
 {
     // get rook attacks assuming current board occupancy
-    occupancy &= rook_masks[square];
-    occupancy *= rook_magic_numbers[square];
-    occupancy >>= 64 - rook_relevant_bits[square];
+    #ifdef USE_PEXT
+        occupancy = _pext_u64(occupancy, rook_masks[square]);
+    #else
+        occupancy &= rook_masks[square];
+        occupancy *= rook_magic_numbers[square];
+        occupancy >>= 64 - rook_relevant_bits[square];
+    #endif
     
     // return rook attacks
     return rook_attacks[square][occupancy];
@@ -1609,17 +1782,25 @@ static inline U64 get_queen_attacks(int square, U64 occupancy)
     U64 rook_occupancy = occupancy;
     
     // get bishop attacks assuming current board occupancy
-    bishop_occupancy &= bishop_masks[square];
-    bishop_occupancy *= bishop_magic_numbers[square];
-    bishop_occupancy >>= 64 - bishop_relevant_bits[square];
+    #ifdef USE_PEXT
+        bishop_occupancy = _pext_u64(bishop_occupancy, bishop_masks[square]);
+    #else
+        bishop_occupancy &= bishop_masks[square];
+        bishop_occupancy *= bishop_magic_numbers[square];
+        bishop_occupancy >>= 64 - bishop_relevant_bits[square];
+    #endif
     
     // get bishop attacks
     queen_attacks = bishop_attacks[square][bishop_occupancy];
     
     // get rook attacks assuming current board occupancy
-    rook_occupancy &= rook_masks[square];
-    rook_occupancy *= rook_magic_numbers[square];
-    rook_occupancy >>= 64 - rook_relevant_bits[square];
+    #ifdef USE_PEXT
+        rook_occupancy = _pext_u64(rook_occupancy, rook_masks[square]);
+    #else
+        rook_occupancy &= rook_masks[square];
+        rook_occupancy *= rook_magic_numbers[square];
+        rook_occupancy >>= 64 - rook_relevant_bits[square];
+    #endif
     
     // get rook attacks
     queen_attacks |= rook_attacks[square][rook_occupancy];
@@ -1637,8 +1818,8 @@ static inline U64 get_queen_attacks(int square, U64 occupancy)
  ==================================
 \**********************************/
 
-// is square current given attacked by the current given side
-static inline int is_square_attacked(int square, int side)
+// is square attacked by the given side with the given occupancy (sliders attack through missing pieces)
+static inline int is_square_attacked_with(int square, int side, U64 occupancy)
 {
     // attacked by white pawns
     if ((side == white) && (pawn_attacks[black][square] & bitboards[P])) return 1;
@@ -1650,13 +1831,13 @@ static inline int is_square_attacked(int square, int side)
     if (knight_attacks[square] & ((side == white) ? bitboards[N] : bitboards[n])) return 1;
     
     // attacked by bishops
-    if (get_bishop_attacks(square, occupancies[both]) & ((side == white) ? bitboards[B] : bitboards[b])) return 1;
+    if (get_bishop_attacks(square, occupancy) & ((side == white) ? bitboards[B] : bitboards[b])) return 1;
 
     // attacked by rooks
-    if (get_rook_attacks(square, occupancies[both]) & ((side == white) ? bitboards[R] : bitboards[r])) return 1;    
+    if (get_rook_attacks(square, occupancy) & ((side == white) ? bitboards[R] : bitboards[r])) return 1;    
 
     // attacked by bishops
-    if (get_queen_attacks(square, occupancies[both]) & ((side == white) ? bitboards[Q] : bitboards[q])) return 1;
+    if (get_queen_attacks(square, occupancy) & ((side == white) ? bitboards[Q] : bitboards[q])) return 1;
     
     // attacked by kings
     if (king_attacks[square] & ((side == white) ? bitboards[K] : bitboards[k])) return 1;
@@ -1665,6 +1846,170 @@ static inline int is_square_attacked(int square, int side)
     return 0;
 }
 
+// is square current given attacked by the current given side
+static inline int is_square_attacked(int square, int side)
+{
+    return is_square_attacked_with(square, side, occupancies[both]);
+}
+
+/*
+    Move generator is legal: checkers & pinned pieces are found once per
+    node (init_legal_masks) and generated moves are restricted to them
+    the way Gigantua's checkmask & pinmask do it:
+    
+      - in check non-king moves have to capture the checker or block the
+        check (check mask), in double check only the king can move
+      - pinned piece has to stay on the line through its king & itself
+      - king can't step on a square attacked with the king itself removed
+        from the board (so it doesn't hide behind itself from a slider)
+      - enpassant capture removes two pieces from a rank, so it's tested
+        with the resulting occupancy
+    
+    So make_move() doesn't test moves for legality and perft counts the
+    moves at depth 1 without making them.
+*/
+
+// squares in between two squares on the same line (empty if not aligned)
+U64 between_masks[64][64];
+
+// full line through two squares (empty if not aligned)
+U64 line_masks[64][64];
+
+// legality data of the position
+typedef struct {
+    int king_square;        // king of the side to move
+    U64 checkers;           // pieces giving check
+    U64 check_mask;         // squares non-king moves have to go to (all of them if not in check)
+    U64 pinned;             // pieces pinned to the king
+} legal_masks;
+
+// init between & line masks
+void init_line_masks()
+{
+    // loop over square pairs
+    for (int source_square = 0; source_square < 64; source_square++)
+    {
+        for (int target_square = 0; target_square < 64; target_square++)
+        {
+            between_masks[source_square][target_square] = 0ULL;
+            line_masks[source_square][target_square] = 0ULL;
+            
+            if (source_square == target_square)
+                continue;
+            
+            // both squares as blockers
+            U64 source = 1ULL << source_square, target = 1ULL << target_square;
+            
+            // squares are on the same diagonal
+            if (bishop_attacks_on_the_fly(source_square, 0ULL) & target)
+            {
+                between_masks[source_square][target_square] = bishop_attacks_on_the_fly(source_square, target) &
+                                                              bishop_attacks_on_the_fly(target_square, source);
+                line_masks[source_square][target_square] = (bishop_attacks_on_the_fly(source_square, 0ULL) &
+                                                            bishop_attacks_on_the_fly(target_square, 0ULL)) | source | target;
+            }
+            
+            // squares are on the same rank or file
+            if (rook_attacks_on_the_fly(source_square, 0ULL) & target)
+            {
+                between_masks[source_square][target_square] = rook_attacks_on_the_fly(source_square, target) &
+                                                              rook_attacks_on_the_fly(target_square, source);
+                line_masks[source_square][target_square] = (rook_attacks_on_the_fly(source_square, 0ULL) &
+                                                            rook_attacks_on_the_fly(target_square, 0ULL)) | source | target;
+            }
+        }
+    }
+}
+
+// find checkers & pinned pieces of the side to move
+static inline void init_legal_masks(legal_masks *masks)
+{
+    // opponent's pieces
+    int start_piece = (side == white) ? p : P;
+    
+    // king square
+    int king_square = get_ls1b_index(bitboards[(side == white) ? K : k]);
+    masks->king_square = king_square;
+    
+    // checks by pawns & knights
+    masks->checkers = (pawn_attacks[side][king_square] & bitboards[start_piece]) |
+                      (knight_attacks[king_square] & bitboards[start_piece + N]);
+    
+    masks->pinned = 0ULL;
+    
+    // opponent's sliders aligned with the king through opponent's pieces only
+    U64 snipers = (get_bishop_attacks(king_square, occupancies[side ^ 1]) & (bitboards[start_piece + B] | bitboards[start_piece + Q])) |
+                  (get_rook_attacks(king_square, occupancies[side ^ 1]) & (bitboards[start_piece + R] | bitboards[start_piece + Q]));
+    
+    // loop over snipers
+    while (snipers)
+    {
+        int sniper_square = get_ls1b_index(snipers);
+        
+        // pieces in between the sniper & the king
+        U64 blockers = between_masks[king_square][sniper_square] & occupancies[both];
+        
+        // nothing in between gives check
+        if (blockers == 0)
+            masks->checkers |= 1ULL << sniper_square;
+        
+        // single own piece in between is pinned
+        else if ((blockers & (blockers - 1)) == 0)
+            masks->pinned |= blockers & occupancies[side];
+        
+        pop_bit(snipers, sniper_square);
+    }
+    
+    // not in check: all squares are fine
+    if (masks->checkers == 0)
+        masks->check_mask = ~0ULL;
+    
+    // double check: only king can move
+    else if (masks->checkers & (masks->checkers - 1))
+        masks->check_mask = 0ULL;
+    
+    // single check: capture the checker or block the check
+    else
+        masks->check_mask = masks->checkers | between_masks[king_square][get_ls1b_index(masks->checkers)];
+}
+
+// squares a piece on the source square may legally go to (king excluded)
+static inline U64 legal_targets(legal_masks *masks, int source_square)
+{
+    // pinned piece stays on the line through the king
+    if (get_bit(masks->pinned, source_square))
+        return masks->check_mask & line_masks[masks->king_square][source_square];
+    
+    return masks->check_mask;
+}
+
+// is king move to the target square legal (king is taken off the board not to block sliders)
+static inline int is_king_move_legal(legal_masks *masks, int target_square)
+{
+    return !is_square_attacked_with(target_square, side ^ 1, occupancies[both] ^ (1ULL << masks->king_square));
+}
+
+// is enpassant capture legal (two pieces leave the same rank, so test the occupancy after capture)
+static inline int is_enpassant_legal(legal_masks *masks, int source_square, int target_square)
+{
+    // opponent's pieces
+    int start_piece = (side == white) ? p : P;
+    
+    // captured pawn square
+    int captured_square = target_square + ((side == white) ? 8 : -8);
+    
+    // occupancy after capture
+    U64 occupancy = (occupancies[both] ^ (1ULL << source_square) ^ (1ULL << captured_square)) | (1ULL << target_square);
+    
+    // king can't stay in check by a knight
+    if (masks->checkers & ~(1ULL << captured_square) & bitboards[start_piece + N])
+        return 0;
+    
+    // king can't be exposed to sliders
+    return !(get_bishop_attacks(masks->king_square, occupancy) & (bitboards[start_piece + B] | bitboards[start_piece + Q])) &&
+           !(get_rook_attacks(masks->king_square, occupancy) & (bitboards[start_piece + R] | bitboards[start_piece + Q]));
+}
+
 // print attacked squares
 void print_attacked_squares(int side)
 {
@@ -1825,21 +2170,23 @@ void print_move_list(moves *move_list)
 // preserve board state
 #define copy_board()                                                      \
     U64 bitboards_copy[12], occupancies_copy[3];                          \
-    int side_copy, enpassant_copy, castle_copy;                           \
+    int side_copy, enpassant_copy, castle_copy, fifty_copy;               \
     memcpy(bitboards_copy, bitboards, 96);                                \
     memcpy(occupancies_copy, occupancies, 24);                            \
     side_copy = side, enpassant_copy = enpassant, castle_copy = castle;   \
-    U64 hash_key_copy = hash_key;                                         \
+    fifty_copy = fifty;                                                   \
+    U64 hash_key_copy = hash_key, pawn_key_copy = pawn_key;               \
 
 // restore board state
 #define take_back()                                                       \
     memcpy(bitboards, bitboards_copy, 96);                                \
     memcpy(occupancies, occupancies_copy, 24);                            \
     side = side_copy, enpassant = enpassant_copy, castle = castle_copy;   \
-    hash_key = hash_key_copy;                                             \
+    fifty = fifty_copy;                                                   \
+    hash_key = hash_key_copy, pawn_key = pawn_key_copy;                   \
 
 // move types
-enum { all_moves, only_captures };
+enum { all_moves, only_captures, only_quiets };
 
 /*
                            castling   move     in      in
@@ -1869,15 +2216,30 @@ const int castling_rights[64] = {
     13, 15, 15, 15, 12, 15, 15, 14
 };
 
-// make move on chess board
+// convert BBC piece code to Stockfish piece codes
+int nnue_pieces[12] = { 6, 5, 4, 3, 2, 1, 12, 11, 10, 9, 8, 7 };
+
+// convert BBC square indicies to Stockfish indicies
+int nnue_squares[64] = {
+    a1, b1, c1, d1, e1, f1, g1, h1,
+	a2, b2, c2, d2, e2, f2, g2, h2,
+	a3, b3, c3, d3, e3, f3, g3, h3,
+	a4, b4, c4, d4, e4, f4, g4, h4,
+	a5, b5, c5, d5, e5, f5, g5, h5,
+	a6, b6, c6, d6, e6, f6, g6, h6,
+	a7, b7, c7, d7, e7, f7, g7, h7,
+	a8, b8, c8, d8, e8, f8, g8, h8
+};
+
+// prefetch hash table bucket (defined in transposition table section)
+static inline void prefetch_hash_entry(U64 key);
+
+// make move on chess board (moves are legal, returns 0 only for non-capture with only_captures flag)
 static inline int make_move(int move, int move_flag)
 {
     // quiet moves
     if (move_flag == all_moves)
     {
-        // preserve board state
-        copy_board();
-        
         // parse move
         int source_square = get_move_source(move);
         int target_square = get_move_target(move);
@@ -1888,6 +2250,16 @@ static inline int make_move(int move, int move_flag)
         int enpass = get_move_enpassant(move);
         int castling = get_move_castling(move);
         
+        // init pieces changed by the move for NNUE (64 stands for no square)
+        DirtyPiece *dirty_piece = &nnue_stack[ply].dirtyPiece;
+        nnue_stack[ply].accumulator.computedAccumulation = 0;
+        
+        // moving piece always goes first (NNUE relies on it to detect king moves)
+        dirty_piece->dirtyNum = 1;
+        dirty_piece->pc[0] = nnue_pieces[piece];
+        dirty_piece->from[0] = nnue_squares[source_square];
+        dirty_piece->to[0] = nnue_squares[target_square];
+        
         // move piece
         pop_bit(bitboards[piece], source_square);
         set_bit(bitboards[piece], target_square);
@@ -1896,6 +2268,13 @@ static inline int make_move(int move, int move_flag)
         hash_key ^= piece_keys[piece][source_square]; // remove piece from source square in hash key
         hash_key ^= piece_keys[piece][target_square]; // set piece to the target square in hash key
         
+        // hash pawn move in pawn key
+        if (piece == P || piece == p)
+            pawn_key ^= piece_keys[piece][source_square] ^ piece_keys[piece][target_square];
+        
+        // reset fifty move counter on captures & pawn moves
+        fifty = (capture || piece == P || piece == p) ? 0 : fifty + 1;
+        
         // handling capture moves
         if (capture)
         {
@@ -1927,6 +2306,16 @@ static inline int make_move(int move, int move_flag)
                     
                     // remove the piece from hash key
                     hash_key ^= piece_keys[bb_piece][target_square];
+                    
+                    // remove captured pawn from pawn key
+                    if (bb_piece == P || bb_piece == p)
+                        pawn_key ^= piece_keys[bb_piece][target_square];
+                    
+                    // captured piece leaves the board
+                    dirty_piece->pc[dirty_piece->dirtyNum] = nnue_pieces[bb_piece];
+                    dirty_piece->from[dirty_piece->dirtyNum] = nnue_squares[target_square];
+                    dirty_piece->to[dirty_piece->dirtyNum] = 64;
+                    dirty_piece->dirtyNum++;
                     break;
                 }
             }
@@ -1941,8 +2330,9 @@ static inline int make_move(int move, int move_flag)
                 // erase the pawn from the target square
                 pop_bit(bitboards[P], target_square);
                 
-                // remove pawn from hash key
+                // remove pawn from hash and pawn keys
                 hash_key ^= piece_keys[P][target_square];
+                pawn_key ^= piece_keys[P][target_square];
             }
             
             // black to move
@@ -1951,8 +2341,9 @@ static inline int make_move(int move, int move_flag)
                 // erase the pawn from the target square
                 pop_bit(bitboards[p], target_square);
                 
-                // remove pawn from hash key
+                // remove pawn from hash and pawn keys
                 hash_key ^= piece_keys[p][target_square];
+                pawn_key ^= piece_keys[p][target_square];
             }
             
             // set up promoted piece on chess board
@@ -1960,6 +2351,13 @@ static inline int make_move(int move, int move_flag)
             
             // add promoted piece into the hash key
             hash_key ^= piece_keys[promoted_piece][target_square];
+            
+            // pawn vanishes and promoted piece appears on the target square
+            dirty_piece->to[0] = 64;
+            dirty_piece->pc[dirty_piece->dirtyNum] = nnue_pieces[promoted_piece];
+            dirty_piece->from[dirty_piece->dirtyNum] = 64;
+            dirty_piece->to[dirty_piece->dirtyNum] = nnue_squares[target_square];
+            dirty_piece->dirtyNum++;
         }
         
         // handle enpassant captures
@@ -1975,8 +2373,13 @@ static inline int make_move(int move, int move_flag)
                 // remove captured pawn
                 pop_bit(bitboards[p], target_square + 8);
                 
-                // remove pawn from hash key
+                // remove pawn from hash and pawn keys
                 hash_key ^= piece_keys[p][target_square + 8];
+                pawn_key ^= piece_keys[p][target_square + 8];
+                
+                // captured pawn leaves the board
+                dirty_piece->pc[1] = nnue_pieces[p];
+                dirty_piece->from[1] = nnue_squares[target_square + 8];
             }
             
             // black to move
@@ -1985,9 +2388,18 @@ static inline int make_move(int move, int move_flag)
                 // remove captured pawn
                 pop_bit(bitboards[P], target_square - 8);
                 
-                // remove pawn from hash key
+                // remove pawn from hash and pawn keys
                 hash_key ^= piece_keys[P][target_square - 8];
+                pawn_key ^= piece_keys[P][target_square - 8];
+                
+                // captured pawn leaves the board
+                dirty_piece->pc[1] = nnue_pieces[P];
+                dirty_piece->from[1] = nnue_squares[target_square - 8];
             }
+            
+            // enpassant capture changes two pieces
+            dirty_piece->to[1] = 64;
+            dirty_piece->dirtyNum = 2;
         }
         
         // hash enpassant if available (remove enpassant square from hash key )
@@ -2023,6 +2435,11 @@ static inline int make_move(int move, int move_flag)
         // handle castling moves
         if (castling)
         {
+            // rook is the second piece changed by castling
+            dirty_piece->dirtyNum = 2;
+            dirty_piece->pc[1] = nnue_pieces[(side == white) ? R : r];
+            
+
             // switch target square
             switch (target_square)
             {
@@ -2035,6 +2452,10 @@ static inline int make_move(int move, int move_flag)
                     // hash rook
                     hash_key ^= piece_keys[R][h1];  // remove rook from h1 from hash key
                     hash_key ^= piece_keys[R][f1];  // put rook on f1 into a hash key
+                    
+                    // NNUE rook squares
+                    dirty_piece->from[1] = nnue_squares[h1];
+                    dirty_piece->to[1] = nnue_squares[f1];
                     break;
                 
                 // white castles queen side
@@ -2046,6 +2467,10 @@ static inline int make_move(int move, int move_flag)
                     // hash rook
                     hash_key ^= piece_keys[R][a1];  // remove rook from a1 from hash key
                     hash_key ^= piece_keys[R][d1];  // put rook on d1 into a hash key
+                    
+                    // NNUE rook squares
+                    dirty_piece->from[1] = nnue_squares[a1];
+                    dirty_piece->to[1] = nnue_squares[d1];
                     break;
                 
                 // black castles king side
@@ -2057,6 +2482,10 @@ static inline int make_move(int move, int move_flag)
                     // hash rook
                     hash_key ^= piece_keys[r][h8];  // remove rook from h8 from hash key
                     hash_key ^= piece_keys[r][f8];  // put rook on f8 into a hash key
+                    
+                    // NNUE rook squares
+                    dirty_piece->from[1] = nnue_squares[h8];
+                    dirty_piece->to[1] = nnue_squares[f8];
                     break;
                 
                 // black castles queen side
@@ -2068,6 +2497,10 @@ static inline int make_move(int move, int move_flag)
                     // hash rook
                     hash_key ^= piece_keys[r][a8];  // remove rook from a8 from hash key
                     hash_key ^= piece_keys[r][d8];  // put rook on d8 into a hash key
+                    
+                    // NNUE rook squares
+                    dirty_piece->from[1] = nnue_squares[a8];
+                    dirty_piece->to[1] = nnue_squares[d8];
                     break;
             }
         }
@@ -2105,22 +2538,11 @@ static inline int make_move(int move, int move_flag)
         // hash side
         hash_key ^= side_key;
         
-        // make sure that king has not been exposed into a check
-        if (is_square_attacked((side == white) ? get_ls1b_index(bitboards[k]) : get_ls1b_index(bitboards[K]), side))
-        {
-            // take move back
-            take_back();
-            
-            // return illegal move
-            return 0;
-        }
+        // start loading child position's TT bucket
+        prefetch_hash_entry(hash_key);
         
-        // otherwise
-        else
-            // return legal move
-            return 1;
-            
-            
+        // move generator makes sure the king isn't exposed into a check
+        return 1;
     }
     
     // capture moves
@@ -2128,7 +2550,7 @@ static inline int make_move(int move, int move_flag)
     {
         // make sure move is the capture
         if (get_move_capture(move))
-            make_move(move, all_moves);
+            return make_move(move, all_moves);
         
         // otherwise the move is not a capture
         else
@@ -2137,21 +2559,26 @@ static inline int make_move(int move, int move_flag)
     }
 }
 
-// generate all moves
-static inline void generate_moves(moves *move_list)
+// generate legal moves of given type
+static inline void generate_moves_of_type(moves *move_list, int move_type, legal_masks *masks)
 {
-    // init move count
-    move_list->count = 0;
-
     // define source & target squares
     int source_square, target_square;
     
-    // define current piece's bitboard copy & it's attacks
-    U64 bitboard, attacks;
+    // define current piece's bitboard copy, it's attacks & squares it may legally go to
+    U64 bitboard, attacks, allowed;
+    
+    // squares pieces may move to (empty & opponent's, opponent's or empty ones)
+    U64 targets = (move_type == all_moves) ? ~occupancies[side] :
+                  (move_type == only_captures) ? occupancies[side ^ 1] : ~occupancies[both];
     
     // loop over all the bitboards
     for (int piece = P; piece <= k; piece++)
     {
+        // only king can move in double check
+        if (masks->check_mask == 0 && piece != K && piece != k)
+            continue;
+        
         // init piece bitboard copy
         bitboard = bitboards[piece];
         
@@ -2170,31 +2597,38 @@ static inline void generate_moves(moves *move_list)
                     // init target square
                     target_square = source_square - 8;
                     
+                    // init squares the pawn may legally go to
+                    allowed = legal_targets(masks, source_square);
+                    
                     // generate quiet pawn moves
-                    if (!(target_square < a8) && !get_bit(occupancies[both], target_square))
+                    if (move_type != only_captures && !(target_square < a8) && !get_bit(occupancies[both], target_square))
                     {
                         // pawn promotion
                         if (source_square >= a7 && source_square <= h7)
-                        {                            
-                            add_move(move_list, encode_move(source_square, target_square, piece, Q, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, R, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, B, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, N, 0, 0, 0, 0));
+                        {
+                            if (get_bit(allowed, target_square))
+                            {
+                                add_move(move_list, encode_move(source_square, target_square, piece, Q, 0, 0, 0, 0));
+                                add_move(move_list, encode_move(source_square, target_square, piece, R, 0, 0, 0, 0));
+                                add_move(move_list, encode_move(source_square, target_square, piece, B, 0, 0, 0, 0));
+                                add_move(move_list, encode_move(source_square, target_square, piece, N, 0, 0, 0, 0));
+                            }
                         }
                         
                         else
                         {
                             // one square ahead pawn move
-                            add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
+                            if (get_bit(allowed, target_square))
+                                add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
                             
                             // two squares ahead pawn move
-                            if ((source_square >= a2 && source_square <= h2) && !get_bit(occupancies[both], target_square - 8))
+                            if ((source_square >= a2 && source_square <= h2) && !get_bit(occupancies[both], target_square - 8) && get_bit(allowed, target_square - 8))
                                 add_move(move_list, encode_move(source_square, target_square - 8, piece, 0, 0, 1, 0, 0));
                         }
                     }
                     
                     // init pawn attacks bitboard
-                    attacks = pawn_attacks[side][source_square] & occupancies[black];
+                    attacks = (move_type != only_quiets) ? pawn_attacks[side][source_square] & occupancies[black] & allowed : 0;
                     
                     // generate pawn captures
                     while (attacks)
@@ -2220,13 +2654,13 @@ static inline void generate_moves(moves *move_list)
                     }
                     
                     // generate enpassant captures
-                    if (enpassant != no_sq)
+                    if (move_type != only_quiets && enpassant != no_sq)
                     {
                         // lookup pawn attacks and bitwise AND with enpassant square (bit)
                         U64 enpassant_attacks = pawn_attacks[side][source_square] & (1ULL << enpassant);
                         
                         // make sure enpassant capture available
-                        if (enpassant_attacks)
+                        if (enpassant_attacks && is_enpassant_legal(masks, source_square, enpassant))
                         {
                             // init enpassant capture target square
                             int target_enpassant = get_ls1b_index(enpassant_attacks);
@@ -2240,7 +2674,7 @@ static inline void generate_moves(moves *move_list)
             }
             
             // castling moves
-            if (piece == K)
+            if (piece == K && move_type != only_captures)
             {
                 // king side castling is available
                 if (castle & wk)
@@ -2248,8 +2682,8 @@ static inline void generate_moves(moves *move_list)
                     // make sure square between king and king's rook are empty
                     if (!get_bit(occupancies[both], f1) && !get_bit(occupancies[both], g1))
                     {
-                        // make sure king and the f1 squares are not under attacks
-                        if (!is_square_attacked(e1, black) && !is_square_attacked(f1, black))
+                        // make sure king, the f1 & g1 squares are not under attacks
+                        if (!masks->checkers && !is_square_attacked(f1, black) && !is_square_attacked(g1, black))
                             add_move(move_list, encode_move(e1, g1, piece, 0, 0, 0, 0, 1));
                     }
                 }
@@ -2260,8 +2694,8 @@ static inline void generate_moves(moves *move_list)
                     // make sure square between king and queen's rook are empty
                     if (!get_bit(occupancies[both], d1) && !get_bit(occupancies[both], c1) && !get_bit(occupancies[both], b1))
                     {
-                        // make sure king and the d1 squares are not under attacks
-                        if (!is_square_attacked(e1, black) && !is_square_attacked(d1, black))
+                        // make sure king, the d1 & c1 squares are not under attacks
+                        if (!masks->checkers && !is_square_attacked(d1, black) && !is_square_attacked(c1, black))
                             add_move(move_list, encode_move(e1, c1, piece, 0, 0, 0, 0, 1));
                     }
                 }
@@ -2283,31 +2717,38 @@ static inline void generate_moves(moves *move_list)
                     // init target square
                     target_square = source_square + 8;
                     
+                    // init squares the pawn may legally go to
+                    allowed = legal_targets(masks, source_square);
+                    
                     // generate quiet pawn moves
-                    if (!(target_square > h1) && !get_bit(occupancies[both], target_square))
+                    if (move_type != only_captures && !(target_square > h1) && !get_bit(occupancies[both], target_square))
                     {
                         // pawn promotion
                         if (source_square >= a2 && source_square <= h2)
                         {
-                            add_move(move_list, encode_move(source_square, target_square, piece, q, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, r, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, b, 0, 0, 0, 0));
-                            add_move(move_list, encode_move(source_square, target_square, piece, n, 0, 0, 0, 0));
+                            if (get_bit(allowed, target_square))
+                            {
+                                add_move(move_list, encode_move(source_square, target_square, piece, q, 0, 0, 0, 0));
+                                add_move(move_list, encode_move(source_square, target_square, piece, r, 0, 0, 0, 0));
+                                add_move(move_list, encode_move(source_square, target_square, piece, b, 0, 0, 0, 0));
+                                add_move(move_list, encode_move(source_square, target_square, piece, n, 0, 0, 0, 0));
+                            }
                         }
                         
                         else
                         {
                             // one square ahead pawn move
-                            add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
+                            if (get_bit(allowed, target_square))
+                                add_move(move_list, encode_move(source_square, target_square, piece, 0, 0, 0, 0, 0));
                             
                             // two squares ahead pawn move
-                            if ((source_square >= a7 && source_square <= h7) && !get_bit(occupancies[both], target_square + 8))
+                            if ((source_square >= a7 && source_square <= h7) && !get_bit(occupancies[both], target_square + 8) && get_bit(allowed, target_square + 8))
                                 add_move(move_list, encode_move(source_square, target_square + 8, piece, 0, 0, 1, 0, 0));
                         }
                     }
                     
                     // init pawn attacks bitboard
-                    attacks = pawn_attacks[side][source_square] & occupancies[white];
+                    attacks = (move_type != only_quiets) ? pawn_attacks[side][source_square] & occupancies[white] & allowed : 0;
                     
                     // generate pawn captures
                     while (attacks)
@@ -2333,13 +2774,13 @@ static inline void generate_moves(moves *move_list)
                     }
                     
                     // generate enpassant captures
-                    if (enpassant != no_sq)
+                    if (move_type != only_quiets && enpassant != no_sq)
                     {
                         // lookup pawn attacks and bitwise AND with enpassant square (bit)
                         U64 enpassant_attacks = pawn_attacks[side][source_square] & (1ULL << enpassant);
                         
                         // make sure enpassant capture available
-                        if (enpassant_attacks)
+                        if (enpassant_attacks && is_enpassant_legal(masks, source_square, enpassant))
                         {
                             // init enpassant capture target square
                             int target_enpassant = get_ls1b_index(enpassant_attacks);
@@ -2353,7 +2794,7 @@ static inline void generate_moves(moves *move_list)
             }
             
             // castling moves
-            if (piece == k)
+            if (piece == k && move_type != only_captures)
             {
                 // king side castling is available
                 if (castle & bk)
@@ -2361,8 +2802,8 @@ static inline void generate_moves(moves *move_list)
                     // make sure square between king and king's rook are empty
                     if (!get_bit(occupancies[both], f8) && !get_bit(occupancies[both], g8))
                     {
-                        // make sure king and the f8 squares are not under attacks
-                        if (!is_square_attacked(e8, white) && !is_square_attacked(f8, white))
+                        // make sure king, the f8 & g8 squares are not under attacks
+                        if (!masks->checkers && !is_square_attacked(f8, white) && !is_square_attacked(g8, white))
                             add_move(move_list, encode_move(e8, g8, piece, 0, 0, 0, 0, 1));
                     }
                 }
@@ -2373,8 +2814,8 @@ static inline void generate_moves(moves *move_list)
                     // make sure square between king and queen's rook are empty
                     if (!get_bit(occupancies[both], d8) && !get_bit(occupancies[both], c8) && !get_bit(occupancies[both], b8))
                     {
-                        // make sure king and the d8 squares are not under attacks
-                        if (!is_square_attacked(e8, white) && !is_square_attacked(d8, white))
+                        // make sure king, the d8 & c8 squares are not under attacks
+                        if (!masks->checkers && !is_square_attacked(d8, white) && !is_square_attacked(c8, white))
                             add_move(move_list, encode_move(e8, c8, piece, 0, 0, 0, 0, 1));
                     }
                 }
@@ -2391,7 +2832,7 @@ static inline void generate_moves(moves *move_list)
                 source_square = get_ls1b_index(bitboard);
                 
                 // init piece attacks in order to get set of target squares
-                attacks = knight_attacks[source_square] & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
+                attacks = knight_attacks[source_square] & targets & legal_targets(masks, source_square);
                 
                 // loop over target squares available from generated attacks
                 while (attacks)
@@ -2427,7 +2868,7 @@ static inline void generate_moves(moves *move_list)
                 source_square = get_ls1b_index(bitboard);
                 
                 // init piece attacks in order to get set of target squares
-                attacks = get_bishop_attacks(source_square, occupancies[both]) & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
+                attacks = get_bishop_attacks(source_square, occupancies[both]) & targets & legal_targets(masks, source_square);
                 
                 // loop over target squares available from generated attacks
                 while (attacks)
@@ -2463,7 +2904,7 @@ static inline void generate_moves(moves *move_list)
                 source_square = get_ls1b_index(bitboard);
                 
                 // init piece attacks in order to get set of target squares
-                attacks = get_rook_attacks(source_square, occupancies[both]) & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
+                attacks = get_rook_attacks(source_square, occupancies[both]) & targets & legal_targets(masks, source_square);
                 
                 // loop over target squares available from generated attacks
                 while (attacks)
@@ -2499,7 +2940,7 @@ static inline void generate_moves(moves *move_list)
                 source_square = get_ls1b_index(bitboard);
                 
                 // init piece attacks in order to get set of target squares
-                attacks = get_queen_attacks(source_square, occupancies[both]) & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
+                attacks = get_queen_attacks(source_square, occupancies[both]) & targets & legal_targets(masks, source_square);
                 
                 // loop over target squares available from generated attacks
                 while (attacks)
@@ -2535,7 +2976,20 @@ static inline void generate_moves(moves *move_list)
                 source_square = get_ls1b_index(bitboard);
                 
                 // init piece attacks in order to get set of target squares
-                attacks = king_attacks[source_square] & ((side == white) ? ~occupancies[white] : ~occupancies[black]);
+                attacks = king_attacks[source_square] & targets;
+                
+                // drop attacked target squares
+                allowed = attacks;
+                
+                while (allowed)
+                {
+                    target_square = get_ls1b_index(allowed);
+                    
+                    if (!is_king_move_legal(masks, target_square))
+                        pop_bit(attacks, target_square);
+                    
+                    pop_bit(allowed, target_square);
+                }
                 
                 // loop over target squares available from generated attacks
                 while (attacks)
@@ -2563,58 +3017,376 @@ static inline void generate_moves(moves *move_list)
 }
 
 
-/**********************************\
- ==================================
- 
-               Perft
- 
- ==================================
+// generate all moves
+static inline void generate_moves(moves *move_list)
+{
+    // init move count
+    move_list->count = 0;
+    
+    // find checkers & pinned pieces
+    legal_masks masks[1];
+    init_legal_masks(masks);
+    
+    // append moves of all types
+    generate_moves_of_type(move_list, all_moves, masks);
+}
+
+// check whether a move (hash, PV or killer move) is possible in the current position
+static inline int is_pseudo_legal(int move)
+{
+    // parse move
+    int source_square = get_move_source(move);
+    int target_square = get_move_target(move);
+    int piece = get_move_piece(move);
+    int promoted_piece = get_move_promoted(move);
+    int capture = get_move_capture(move);
+    
+    // no move
+    if (move == 0)
+        return 0;
+    
+    // moving piece has to belong to the side to move and stand on the source square
+    if ((side == white ? piece > K : piece < p) || !get_bit(bitboards[piece], source_square))
+        return 0;
+    
+    // target square can't be occupied by own piece
+    if (get_bit(occupancies[side], target_square))
+        return 0;
+    
+    // enpassant capture
+    if (get_move_enpassant(move))
+        return (piece == P || piece == p) && capture && target_square == enpassant &&
+               !promoted_piece && !get_move_double(move) &&
+               get_bit(pawn_attacks[side][source_square], target_square);
+    
+    // capture flag has to match the target square
+    if ((capture != 0) != (get_bit(occupancies[side ^ 1], target_square) != 0))
+        return 0;
+    
+    // castling moves (same conditions as in move generator)
+    if (get_move_castling(move))
+    {
+        if (piece == K && source_square == e1 && target_square == g1)
+            return (castle & wk) && !get_bit(occupancies[both], f1) && !get_bit(occupancies[both], g1) &&
+                   !is_square_attacked(e1, black) && !is_square_attacked(f1, black);
+        
+        if (piece == K && source_square == e1 && target_square == c1)
+            return (castle & wq) && !get_bit(occupancies[both], d1) && !get_bit(occupancies[both], c1) &&
+                   !get_bit(occupancies[both], b1) && !is_square_attacked(e1, black) && !is_square_attacked(d1, black);
+        
+        if (piece == k && source_square == e8 && target_square == g8)
+            return (castle & bk) && !get_bit(occupancies[both], f8) && !get_bit(occupancies[both], g8) &&
+                   !is_square_attacked(e8, white) && !is_square_attacked(f8, white);
+        
+        if (piece == k && source_square == e8 && target_square == c8)
+            return (castle & bq) && !get_bit(occupancies[both], d8) && !get_bit(occupancies[both], c8) &&
+                   !get_bit(occupancies[both], b8) && !is_square_attacked(e8, white) && !is_square_attacked(d8, white);
+        
+        return 0;
+    }
+    
+    // pawn moves
+    if (piece == P || piece == p)
+    {
+        // pawns promote from the 7th rank only
+        int promotion = (side == white) ? (source_square >= a7 && source_square <= h7) :
+                                          (source_square >= a2 && source_square <= h2);
+        
+        if (promotion != (promoted_piece != 0))
+            return 0;
+        
+        // promoted piece has to be a knight, bishop, rook or queen of the side to move
+        if (promoted_piece && ((side == white) ? (promoted_piece < N || promoted_piece > Q) :
+                                                 (promoted_piece < n || promoted_piece > q)))
+            return 0;
+        
+        // pawn captures
+        if (capture)
+            return !get_move_double(move) && get_bit(pawn_attacks[side][source_square], target_square);
+        
+        // pawn push direction
+        int direction = (side == white) ? -8 : 8;
+        
+        // two squares ahead pawn move
+        if (get_move_double(move))
+            return ((side == white) ? (source_square >= a2 && source_square <= h2) :
+                                      (source_square >= a7 && source_square <= h7)) &&
+                   target_square == source_square + 2 * direction &&
+                   !get_bit(occupancies[both], source_square + direction) &&
+                   !get_bit(occupancies[both], target_square);
+        
+        // one square ahead pawn move
+        return target_square == source_square + direction && !get_bit(occupancies[both], target_square);
+    }
+    
+    // only pawn moves carry promotion & double push flags
+    if (promoted_piece || get_move_double(move))
+        return 0;
+    
+    // piece attacks
+    U64 attacks;
+    
+    switch (piece)
+    {
+        case N: case n: attacks = knight_attacks[source_square]; break;
+        case B: case b: attacks = get_bishop_attacks(source_square, occupancies[both]); break;
+        case R: case r: attacks = get_rook_attacks(source_square, occupancies[both]); break;
+        case Q: case q: attacks = get_queen_attacks(source_square, occupancies[both]); break;
+        default: attacks = king_attacks[source_square]; break;
+    }
+    
+    // target square has to be attacked by the piece
+    return get_bit(attacks, target_square) ? 1 : 0;
+}
+
+// check whether a pseudo legal move (hash, PV or killer move) is legal
+static inline int is_legal(int move, legal_masks *masks)
+{
+    // parse move
+    int source_square = get_move_source(move);
+    int target_square = get_move_target(move);
+    
+    // king moves
+    if (source_square == masks->king_square)
+    {
+        // king can't castle out of, through or into check
+        if (get_move_castling(move))
+            return !masks->checkers && !is_square_attacked((source_square + target_square) / 2, side ^ 1) &&
+                   !is_square_attacked(target_square, side ^ 1);
+        
+        return is_king_move_legal(masks, target_square);
+    }
+    
+    // enpassant capture
+    if (get_move_enpassant(move))
+        return is_enpassant_legal(masks, source_square, target_square);
+    
+    // other moves have to resolve check & keep pins
+    return get_bit(legal_targets(masks, source_square), target_square) ? 1 : 0;
+}
+
+
+/**********************************\
+ ==================================
+ 
+               Perft
+ 
+ ==================================
 \**********************************/
 
 // leaf nodes (number of positions reached during the test of the move generator at a given depth)
-U64 nodes;
+__thread U64 nodes;
+
+/*
+    Perft hash entry is shared by all the perft threads without any locks,
+    it stores hash key XOR entry data just like the transposition table.
+
+    bits  0..7   depth
+    bits  8..63  leaf nodes
+*/
+typedef struct {
+    U64 hash_lock;      // hash key XOR data
+    U64 data;           // leaf nodes & depth
+} perft_entry;
+
+// perft hash table (NULL if disabled) & mask to index it
+perft_entry *perft_table = NULL;
+U64 perft_mask = 0;
+
+// perft job: position at split depth reached via one of the root moves
+typedef struct {
+    U64 bitboards[12];
+    U64 occupancies[3];
+    int side, enpassant, castle;
+    U64 hash_key;
+    int root_move;      // index of the root move leading to the position
+} perft_job;
+
+// perft jobs shared by the perft threads
+perft_job *perft_jobs = NULL;
+int perft_job_count = 0;
+int perft_job_capacity = 0;
+
+// next job to take & depth left to search from job positions
+atomic_int perft_next_job;
+int perft_job_depth;
+
+// leaf nodes per root move
+_Atomic U64 perft_root_nodes[256];
 
 // perft driver
-static inline void perft_driver(int depth)
+static inline U64 perft_driver(int depth)
 {
-    // reccursion escape condition
+    // reccursion escape condition (count reached position)
     if (depth == 0)
+        return 1;
+    
+    // perft hash entry of the position at given depth
+    perft_entry *entry = NULL;
+    
+    // probe perft hash table (depth 1 is cheaper to generate than to look up)
+    if (perft_table != NULL && depth > 1)
     {
-        // increment nodes count (count reached positions)
-        nodes++;
-        return;
+        entry = &perft_table[(hash_key + depth * 0x9e3779b97f4a7c15ULL) & perft_mask];
+        
+        U64 data = entry->data;
+        
+        // return stored leaf nodes
+        if ((entry->hash_lock ^ data) == hash_key && (int)(data & 0xff) == depth)
+            return data >> 8;
     }
     
+    // leaf nodes below current position
+    U64 leaf_nodes = 0;
+    
     // create move list instance
     moves move_list[1];
     
     // generate moves
     generate_moves(move_list);
     
-        // loop over generated moves
+    // generated moves are legal, so leaf nodes are counted without making them
+    if (depth == 1)
+        return move_list->count;
+    
+    // loop over generated moves
     for (int move_count = 0; move_count < move_list->count; move_count++)
     {   
         // preserve board state
         copy_board();
         
         // make move
-        if (!make_move(move_list->moves[move_count], all_moves))
-            // skip to the next move
-            continue;
+        make_move(move_list->moves[move_count], all_moves);
         
         // call perft driver recursively
-        perft_driver(depth - 1);
+        leaf_nodes += perft_driver(depth - 1);
+        
+        // take back
+        take_back();        
+    }
+    
+    // store leaf nodes
+    if (entry != NULL)
+    {
+        U64 data = (leaf_nodes << 8) | depth;
+        entry->hash_lock = hash_key ^ data;
+        entry->data = data;
+    }
+    
+    return leaf_nodes;
+}
+
+// add current position as a perft job
+static void add_perft_job(int root_move)
+{
+    // grow jobs array
+    if (perft_job_count == perft_job_capacity)
+    {
+        perft_job_capacity = perft_job_capacity ? perft_job_capacity * 2 : 1024;
+        perft_jobs = realloc(perft_jobs, perft_job_capacity * sizeof(perft_job));
+    }
+    
+    // store board state
+    perft_job *job = &perft_jobs[perft_job_count++];
+    memcpy(job->bitboards, bitboards, 96);
+    memcpy(job->occupancies, occupancies, 24);
+    job->side = side, job->enpassant = enpassant, job->castle = castle;
+    job->hash_key = hash_key;
+    job->root_move = root_move;
+}
+
+// split the tree below a root move into jobs at given depth
+static void split_perft(int depth, int root_move)
+{
+    // split depth reached
+    if (depth == 0)
+    {
+        add_perft_job(root_move);
+        return;
+    }
+    
+    // create move list instance
+    moves move_list[1];
+    
+    // generate moves
+    generate_moves(move_list);
+    
+    // loop over generated moves
+    for (int move_count = 0; move_count < move_list->count; move_count++)
+    {   
+        // preserve board state
+        copy_board();
+        
+        // make move
+        make_move(move_list->moves[move_count], all_moves);
+        
+        // split the subtree
+        split_perft(depth - 1, root_move);
         
         // take back
         take_back();        
     }
 }
 
-// perft test
-void perft_test(int depth)
+// perft thread: take jobs until none left
+void *perft_worker(void *arg)
+{
+    int index;
+    
+    while ((index = atomic_fetch_add(&perft_next_job, 1)) < perft_job_count)
+    {
+        // restore job position
+        perft_job *job = &perft_jobs[index];
+        memcpy(bitboards, job->bitboards, 96);
+        memcpy(occupancies, job->occupancies, 24);
+        side = job->side, enpassant = job->enpassant, castle = job->castle;
+        hash_key = job->hash_key;
+        
+        // count leaf nodes for the root move
+        atomic_fetch_add(&perft_root_nodes[job->root_move], perft_driver(perft_job_depth));
+    }
+    
+    return NULL;
+}
+
+// init perft hash table (mb = 0 disables it)
+void init_perft_table(int mb)
+{
+    // free previous table
+    free(perft_table);
+    perft_table = NULL;
+    perft_mask = 0;
+    
+    if (mb <= 0)
+        return;
+    
+    // round number of entries down to a power of 2
+    U64 entries = 1;
+    while (entries * 2 * sizeof(perft_entry) <= (U64)mb * 0x100000)
+        entries *= 2;
+    
+    // allocate cleared table
+    perft_table = calloc(entries, sizeof(perft_entry));
+    
+    // unable to allocate memory
+    if (perft_table == NULL)
+    {
+        printf("    Couldn't allocate memory for perft hash table, running without it\n");
+        return;
+    }
+    
+    perft_mask = entries - 1;
+}
+
+// perft test (split_depth plies below the root are spread over the threads)
+void perft_test(int depth, int thread_count, int hash_mb, int split_depth)
 {
     printf("\n     Performance test\n\n");
     
+    // clamp split depth
+    if (split_depth < 1) split_depth = 1;
+    if (split_depth > depth) split_depth = depth;
+    
     // create move list instance
     moves move_list[1];
     
@@ -2624,40 +3396,85 @@ void perft_test(int depth)
     // init start time
     long start = get_time_ms();
     
+    // init perft hash table
+    init_perft_table(hash_mb);
+    
+    // split the tree into jobs
+    perft_job_count = 0;
+    
     // loop over generated moves
     for (int move_count = 0; move_count < move_list->count; move_count++)
     {   
+        // reset root move nodes
+        perft_root_nodes[move_count] = 0;
+        
         // preserve board state
         copy_board();
         
         // make move
-        if (!make_move(move_list->moves[move_count], all_moves))
-            // skip to the next move
-            continue;
+        make_move(move_list->moves[move_count], all_moves);
         
-        // cummulative nodes
-        long cummulative_nodes = nodes;
+        // split the subtree below root move
+        split_perft(split_depth - 1, move_count);
         
-        // call perft driver recursively
-        perft_driver(depth - 1);
+        // take back
+        take_back();
+    }
+    
+    // init jobs queue
+    perft_job_depth = depth - split_depth;
+    perft_next_job = 0;
+    
+    // start helper threads
+    pthread_t handles[thread_count];
+    
+    for (int index = 1; index < thread_count; index++)
+        pthread_create(&handles[index], NULL, perft_worker, NULL);
+    
+    // work on jobs in current thread as well
+    {
+        // preserve board state
+        copy_board();
         
-        // old nodes
-        long old_nodes = nodes - cummulative_nodes;
+        perft_worker(NULL);
         
         // take back
         take_back();
+    }
+    
+    // wait for helper threads
+    for (int index = 1; index < thread_count; index++)
+        pthread_join(handles[index], NULL);
+    
+    // total leaf nodes
+    U64 total_nodes = 0;
+    
+    // print nodes per root move
+    for (int move_count = 0; move_count < move_list->count; move_count++)
+    {
+        total_nodes += perft_root_nodes[move_count];
         
         // print move
-        printf("     move: %s%s%c  nodes: %ld\n", square_to_coordinates[get_move_source(move_list->moves[move_count])],
-                                                  square_to_coordinates[get_move_target(move_list->moves[move_count])],
-                                                  get_move_promoted(move_list->moves[move_count]) ? promoted_pieces[get_move_promoted(move_list->moves[move_count])] : ' ',
-                                                  old_nodes);
+        printf("     move: %s%s%c  nodes: %llu\n", square_to_coordinates[get_move_source(move_list->moves[move_count])],
+                                                   square_to_coordinates[get_move_target(move_list->moves[move_count])],
+                                                   get_move_promoted(move_list->moves[move_count]) ? promoted_pieces[get_move_promoted(move_list->moves[move_count])] : ' ',
+                                                   (U64)perft_root_nodes[move_count]);
     }
     
+    // time spent
+    long time_spent = get_time_ms() - start;
+    
     // print results
     printf("\n    Depth: %d\n", depth);
-    printf("    Nodes: %lld\n", nodes);
-    printf("     Time: %ld\n\n", get_time_ms() - start);
+    printf("    Nodes: %llu\n", total_nodes);
+    printf("     Time: %ld\n", time_spent);
+    printf("      NPS: %llu\n\n", total_nodes * 1000 / (time_spent ? time_spent : 1));
+    
+    // free perft memory
+    init_perft_table(0);
+    free(perft_jobs);
+    perft_jobs = NULL;
+    perft_job_capacity = 0;
 }
 
 
@@ -2669,21 +3486,6 @@ void perft_test(int depth)
  ==================================
 \**********************************/
 
-// convert BBC piece code to Stockfish piece codes
-int nnue_pieces[12] = { 6, 5, 4, 3, 2, 1, 12, 11, 10, 9, 8, 7 };
-
-// convert BBC square indicies to Stockfish indicies
-int nnue_squares[64] = {
-    a1, b1, c1, d1, e1, f1, g1, h1,
-	a2, b2, c2, d2, e2, f2, g2, h2,
-	a3, b3, c3, d3, e3, f3, g3, h3,
-	a4, b4, c4, d4, e4, f4, g4, h4,
-	a5, b5, c5, d5, e5, f5, g5, h5,
-	a6, b6, c6, d6, e6, f6, g6, h6,
-	a7, b7, c7, d7, e7, f7, g7, h7,
-	a8, b8, c8, d8, e8, f8, g8, h8
-};
-
 // material scrore
 
 /*
@@ -3096,22 +3898,191 @@ static inline int get_game_phase_score()
     return white_piece_scores + black_piece_scores;
 }
 
-// position evaluation
-static inline int evaluate()
-{   
-    // get game phase score
-    int game_phase_score = get_game_phase_score();
+/*
+    Pawn hash table
+
+    Pawn structure changes only on pawn moves and captures, so the pawn
+    terms of the handcrafted evaluation are cached by pawn key. An entry
+    holds the pawn material, positional and structure (doubled, isolated
+    and passed pawns) scores along with the files left without pawns of
+    each side which rook and king file terms are looked up in.
+*/
+
+// pawn hash table entry
+typedef struct {
+    U64 pawn_key;               // "almost" unique pawn structure identifier
+    U64 semi_open_files[2];     // squares on files without pawns of a side [side]
+    int score_opening;          // pawn structure opening score
+    int score_endgame;          // pawn structure endgame score
+} pawn_entry;
+
+// number of pawn hash table entries per thread (power of two)
+#define pawn_entries 16384
+
+// pawn hash table (thread local, no locking needed)
+__thread pawn_entry pawn_table[pawn_entries];
+
+// pawn hash table probes & hits
+__thread U64 pawn_probes, pawn_hits;
+
+// pawn hash table switch (for benchmarking only)
+int use_pawn_table = 1;
+
+// evaluate pawn structure into the given pawn hash table entry
+static inline void evaluate_pawns(pawn_entry *entry)
+{
+    // pawn structure scores
+    int score_opening = 0, score_endgame = 0;
+    
+    // files without pawns, every file to begin with
+    U64 semi_open_files[2] = { ~0ULL, ~0ULL };
+    
+    // current pawns bitboard copy
+    U64 bitboard;
+    
+    // init square & number of pawns on a file
+    int square, double_pawns;
+    
+    // loop over white pawns
+    bitboard = bitboards[P];
+    
+    while (bitboard)
+    {
+        // init square
+        square = get_ls1b_index(bitboard);
+        
+        // get opening/endgame material score
+        score_opening += material_score[opening][P];
+        score_endgame += material_score[endgame][P];
+        
+        // get opening/endgame positional score
+        score_opening += positional_score[opening][PAWN][square];
+        score_endgame += positional_score[endgame][PAWN][square];
+
+        // double pawn penalty
+        double_pawns = count_bits(bitboards[P] & file_masks[square]);
+        
+        // on double pawns (tripple, etc)
+        if (double_pawns > 1)
+        {
+            score_opening += (double_pawns - 1) * double_pawn_penalty_opening;
+            score_endgame += (double_pawns - 1) * double_pawn_penalty_endgame;
+        }
+        
+        // on isolated pawn
+        if ((bitboards[P] & isolated_masks[square]) == 0)
+        {
+            // give an isolated pawn penalty
+            score_opening += isolated_pawn_penalty_opening;
+            score_endgame += isolated_pawn_penalty_endgame;
+        }
+        // on passed pawn
+        if ((white_passed_masks[square] & bitboards[p]) == 0)
+        {
+            // give passed pawn bonus
+            score_opening += passed_pawn_bonus[get_rank[square]];
+            score_endgame += passed_pawn_bonus[get_rank[square]];
+        }
+        
+        // pawn file is not semi open for white
+        semi_open_files[white] &= ~file_masks[square];
+        
+        // pop ls1b
+        pop_bit(bitboard, square);
+    }
+    
+    // loop over black pawns
+    bitboard = bitboards[p];
+    
+    while (bitboard)
+    {
+        // init square
+        square = get_ls1b_index(bitboard);
+        
+        // get opening/endgame material score
+        score_opening += material_score[opening][p];
+        score_endgame += material_score[endgame][p];
+        
+        // get opening/endgame positional score
+        score_opening -= positional_score[opening][PAWN][mirror_score[square]];
+        score_endgame -= positional_score[endgame][PAWN][mirror_score[square]];
+        
+        // double pawn penalty
+        double_pawns = count_bits(bitboards[p] & file_masks[square]);
+        
+        // on double pawns (tripple, etc)
+        if (double_pawns > 1)
+        {
+            score_opening -= (double_pawns - 1) * double_pawn_penalty_opening;
+            score_endgame -= (double_pawns - 1) * double_pawn_penalty_endgame;
+        }
+        
+        // on isolated pawn
+        if ((bitboards[p] & isolated_masks[square]) == 0)
+        {
+            // give an isolated pawn penalty
+            score_opening -= isolated_pawn_penalty_opening;
+            score_endgame -= isolated_pawn_penalty_endgame;
+        }
+        // on passed pawn
+        if ((black_passed_masks[square] & bitboards[P]) == 0)
+        {
+            // give passed pawn bonus
+            score_opening -= passed_pawn_bonus[get_rank[square]];
+            score_endgame -= passed_pawn_bonus[get_rank[square]];
+        }
+        
+        // pawn file is not semi open for black
+        semi_open_files[black] &= ~file_masks[square];
+        
+        // pop ls1b
+        pop_bit(bitboard, square);
+    }
+    
+    // store pawn structure evaluation
+    entry->pawn_key = pawn_key;
+    entry->semi_open_files[white] = semi_open_files[white];
+    entry->semi_open_files[black] = semi_open_files[black];
+    entry->score_opening = score_opening;
+    entry->score_endgame = score_endgame;
+}
+
+// probe pawn hash table, evaluate pawn structure on a miss
+static inline pawn_entry *probe_pawn_table()
+{
+    // pawn structure evaluation if pawn hash table is off
+    static __thread pawn_entry no_table_entry;
+    
+    // pawn hash table is off
+    if (!use_pawn_table)
+    {
+        evaluate_pawns(&no_table_entry);
+        return &no_table_entry;
+    }
     
-    // game phase (opening, middle game, endgame)
-    int game_phase = -1;
+    // init pawn hash table entry
+    pawn_entry *entry = &pawn_table[pawn_key & (pawn_entries - 1)];
     
-    // pick up game phase based on game phase score
-    if (game_phase_score > opening_phase_score) game_phase = opening;
-    else if (game_phase_score < endgame_phase_score) game_phase = endgame;
-    else game_phase = middlegame;
+    // count probe
+    pawn_probes++;
     
+    // on hit (positions without pawns have zero key as empty entries do)
+    if (entry->pawn_key == pawn_key && pawn_key)
+        pawn_hits++;
+    
+    // on miss replace the entry
+    else
+        evaluate_pawns(entry);
+    
+    // return pawn structure evaluation
+    return entry;
+}
+
+// handcrafted position evaluation
+static inline int evaluate_hce()
+{
     // static evaluation score
-    int score = 0, score_opening = 0, score_endgame = 0;
+    int score_opening = 0, score_endgame = 0;
     
     // current pieces bitboard copy
     U64 bitboard;
@@ -3119,21 +4090,22 @@ static inline int evaluate()
     // init piece & square
     int piece, square;
     
-    // penalties
-    int double_pawns = 0;
-    
-    // array of piece codes converted to Stockfish piece codes
-    int pieces[33];
+    // get pawn structure evaluation
+    pawn_entry *pawns = probe_pawn_table();
     
-    // array of square indices converted to Stockfish square indices
-    int squares[33];
+    // files without pawns of either side
+    U64 open_files = pawns->semi_open_files[white] & pawns->semi_open_files[black];
     
-    // pieces and squares current index to write next piece square pair at
-    int index = 2;
+    // add pawn structure score
+    score_opening += pawns->score_opening;
+    score_endgame += pawns->score_endgame;
     
     // loop over piece bitboards
-    for (int bb_piece = P; bb_piece <= k; bb_piece++)
+    for (int bb_piece = N; bb_piece <= k; bb_piece++)
     {
+        // pawns are evaluated already
+        if (bb_piece == p) continue;
+        
         // init piece bitboard copy
         bitboard = bitboards[bb_piece];
         
@@ -3146,293 +4118,175 @@ static inline int evaluate()
             // init square
             square = get_ls1b_index(bitboard);
             
-            // in opening and middlegame use NNUE evaluation
-            if (game_phase != endgame)
+            // get opening/endgame material score
+            score_opening += material_score[opening][piece];
+            score_endgame += material_score[endgame][piece];
+
+            // score positional piece scores
+            switch (piece)
             {
-                /*
-                    Code to initialize pieces and squares arrays
-                    to serve the purpose of direct probing of NNUE
-                */
+                // evaluate white knights
+                case N:
+                    // get opening/endgame positional score
+                    score_opening += positional_score[opening][KNIGHT][square];
+                    score_endgame += positional_score[endgame][KNIGHT][square];
+                    
+                    break;
                 
-                // case white king
-                if (piece == K)
-                {
-                    /* convert white king piece code to stockfish piece code and
-                       store it at the first index of pieces array
-                    */ 
-                    pieces[0] = nnue_pieces[piece];
+                // evaluate white bishops
+                case B:
+                    // get opening/endgame positional score
+                    score_opening += positional_score[opening][BISHOP][square];
+                    score_endgame += positional_score[endgame][BISHOP][square];
                     
-                    /* convert white king square index to stockfish square index and
-                       store it at the first index of pieces array
-                    */
-                    squares[0] = nnue_squares[square];
-                }
+                    // mobility
+                    score_opening += (count_bits(get_bishop_attacks(square, occupancies[both])) - bishop_unit) * bishop_mobility_opening;
+                    score_endgame += (count_bits(get_bishop_attacks(square, occupancies[both])) - bishop_unit) * bishop_mobility_endgame;                    
+                    break;
                 
-                // case black king
-                else if (piece == k)
-                {
-                    /* convert black king piece code to stockfish piece code and
-                       store it at the second index of pieces array
-                    */
-                    pieces[1] = nnue_pieces[piece];
+                // evaluate white rooks
+                case R:
+                    // get opening/endgame positional score
+                    score_opening += positional_score[opening][ROOK][square];
+                    score_endgame += positional_score[endgame][ROOK][square];
                     
-                    /* convert black king square index to stockfish square index and
-                       store it at the second index of pieces array
-                    */
-                    squares[1] = nnue_squares[square];
-                }
+                    // semi open file
+                    if (get_bit(pawns->semi_open_files[white], square))
+                    {
+                        // add semi open file bonus
+                        score_opening += semi_open_file_score;
+                        score_endgame += semi_open_file_score;
+                    }
+                    
+                    // semi open file
+                    if (get_bit(open_files, square))
+                    {
+                        // add semi open file bonus
+                        score_opening += open_file_score;
+                        score_endgame += open_file_score;
+                    }
+                    
+                    break;
                 
-                // all the rest pieces
-                else
-                {
-                    /*  convert all the rest of piece code with corresponding square codes
-                        to stockfish piece codes and square indicies respectively
-                    */
-                    pieces[index] = nnue_pieces[piece];
-                    squares[index] = nnue_squares[square];
-                    index++;    
-                }
-            }
-            
-            // in the endgame use handcrafted evaluation to speed up engine
-            else
-            {
-                // get opening/endgame material score
-                score_opening += material_score[opening][piece];
-                score_endgame += material_score[endgame][piece];
-
-                // score positional piece scores
-                switch (piece)
-                {
-                    // evaluate white pawns
-                    case P:
-                        // get opening/endgame positional score
-                        score_opening += positional_score[opening][PAWN][square];
-                        score_endgame += positional_score[endgame][PAWN][square];
-
-                        // double pawn penalty
-                        double_pawns = count_bits(bitboards[P] & file_masks[square]);
-                        
-                        // on double pawns (tripple, etc)
-                        if (double_pawns > 1)
-                        {
-                            score_opening += (double_pawns - 1) * double_pawn_penalty_opening;
-                            score_endgame += (double_pawns - 1) * double_pawn_penalty_endgame;
-                        }
-                        
-                        // on isolated pawn
-                        if ((bitboards[P] & isolated_masks[square]) == 0)
-                        {
-                            // give an isolated pawn penalty
-                            score_opening += isolated_pawn_penalty_opening;
-                            score_endgame += isolated_pawn_penalty_endgame;
-                        }
-                        // on passed pawn
-                        if ((white_passed_masks[square] & bitboards[p]) == 0)
-                        {
-                            // give passed pawn bonus
-                            score_opening += passed_pawn_bonus[get_rank[square]];
-                            score_endgame += passed_pawn_bonus[get_rank[square]];
-                        }
-                        
-                        break;
+                // evaluate white queens
+                case Q:
+                    // get opening/endgame positional score
+                    score_opening += positional_score[opening][QUEEN][square];
+                    score_endgame += positional_score[endgame][QUEEN][square];
                     
-                    // evaluate white knights
-                    case N:
-                        // get opening/endgame positional score
-                        score_opening += positional_score[opening][KNIGHT][square];
-                        score_endgame += positional_score[endgame][KNIGHT][square];
-                        
-                        break;
+                    // mobility
+                    score_opening += (count_bits(get_queen_attacks(square, occupancies[both])) - queen_unit) * queen_mobility_opening;
+                    score_endgame += (count_bits(get_queen_attacks(square, occupancies[both])) - queen_unit) * queen_mobility_endgame;                    
+                    break;
+                
+                // evaluate white king
+                case K:
+                    // get opening/endgame positional score
+                    score_opening += positional_score[opening][KING][square];
+                    score_endgame += positional_score[endgame][KING][square];
                     
-                    // evaluate white bishops
-                    case B:
-                        // get opening/endgame positional score
-                        score_opening += positional_score[opening][BISHOP][square];
-                        score_endgame += positional_score[endgame][BISHOP][square];
-                        
-                        // mobility
-                        score_opening += (count_bits(get_bishop_attacks(square, occupancies[both])) - bishop_unit) * bishop_mobility_opening;
-                        score_endgame += (count_bits(get_bishop_attacks(square, occupancies[both])) - bishop_unit) * bishop_mobility_endgame;                    
-                        break;
+                    // semi open file
+                    if (get_bit(pawns->semi_open_files[white], square))
+                    {
+                        // add semi open file penalty
+                        score_opening -= semi_open_file_score;
+                        score_endgame -= semi_open_file_score;
+                    }
                     
-                    // evaluate white rooks
-                    case R:
-                        // get opening/endgame positional score
-                        score_opening += positional_score[opening][ROOK][square];
-                        score_endgame += positional_score[endgame][ROOK][square];
-                        
-                        // semi open file
-                        if ((bitboards[P] & file_masks[square]) == 0)
-                        {
-                            // add semi open file bonus
-                            score_opening += semi_open_file_score;
-                            score_endgame += semi_open_file_score;
-                        }
-                        
-                        // semi open file
-                        if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)
-                        {
-                            // add semi open file bonus
-                            score_opening += open_file_score;
-                            score_endgame += open_file_score;
-                        }
-                        
-                        break;
+                    // semi open file
+                    if (get_bit(open_files, square))
+                    {
+                        // add semi open file penalty
+                        score_opening -= open_file_score;
+                        score_endgame -= open_file_score;
+                    }
                     
-                    // evaluate white queens
-                    case Q:
-                        // get opening/endgame positional score
-                        score_opening += positional_score[opening][QUEEN][square];
-                        score_endgame += positional_score[endgame][QUEEN][square];
-                        
-                        // mobility
-                        score_opening += (count_bits(get_queen_attacks(square, occupancies[both])) - queen_unit) * queen_mobility_opening;
-                        score_endgame += (count_bits(get_queen_attacks(square, occupancies[both])) - queen_unit) * queen_mobility_endgame;                    
-                        break;
+                    // king safety bonus
+                    score_opening += count_bits(king_attacks[square] & occupancies[white]) * king_shield_bonus;
+                    score_endgame += count_bits(king_attacks[square] & occupancies[white]) * king_shield_bonus;
                     
-                    // evaluate white king
-                    case K:
-                        // get opening/endgame positional score
-                        score_opening += positional_score[opening][KING][square];
-                        score_endgame += positional_score[endgame][KING][square];
-                        
-                        // semi open file
-                        if ((bitboards[P] & file_masks[square]) == 0)
-                        {
-                            // add semi open file penalty
-                            score_opening -= semi_open_file_score;
-                            score_endgame -= semi_open_file_score;
-                        }
-                        
-                        // semi open file
-                        if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)
-                        {
-                            // add semi open file penalty
-                            score_opening -= open_file_score;
-                            score_endgame -= open_file_score;
-                        }
-                        
-                        // king safety bonus
-                        score_opening += count_bits(king_attacks[square] & occupancies[white]) * king_shield_bonus;
-                        score_endgame += count_bits(king_attacks[square] & occupancies[white]) * king_shield_bonus;
-                        
-                        break;
-
-                    // evaluate black pawns
-                    case p:
-                        // get opening/endgame positional score
-                        score_opening -= positional_score[opening][PAWN][mirror_score[square]];
-                        score_endgame -= positional_score[endgame][PAWN][mirror_score[square]];
-                        
-                        // double pawn penalty
-                        double_pawns = count_bits(bitboards[p] & file_masks[square]);
-                        
-                        // on double pawns (tripple, etc)
-                        if (double_pawns > 1)
-                        {
-                            score_opening -= (double_pawns - 1) * double_pawn_penalty_opening;
-                            score_endgame -= (double_pawns - 1) * double_pawn_penalty_endgame;
-                        }
-                        
-                        // on isolated pawn
-                        if ((bitboards[p] & isolated_masks[square]) == 0)
-                        {
-                            // give an isolated pawn penalty
-                            score_opening -= isolated_pawn_penalty_opening;
-                            score_endgame -= isolated_pawn_penalty_endgame;
-                        }
-                        // on passed pawn
-                        if ((black_passed_masks[square] & bitboards[P]) == 0)
-                        {
-                            // give passed pawn bonus
-                            score_opening -= passed_pawn_bonus[get_rank[square]];
-                            score_endgame -= passed_pawn_bonus[get_rank[square]];
-                        }
-                        
-                        break;
+                    break;
+                
+                // evaluate black knights
+                case n:
+                    // get opening/endgame positional score
+                    score_opening -= positional_score[opening][KNIGHT][mirror_score[square]];
+                    score_endgame -= positional_score[endgame][KNIGHT][mirror_score[square]];
                     
-                    // evaluate black knights
-                    case n:
-                        // get opening/endgame positional score
-                        score_opening -= positional_score[opening][KNIGHT][mirror_score[square]];
-                        score_endgame -= positional_score[endgame][KNIGHT][mirror_score[square]];
-                        
-                        break;
+                    break;
+                
+                // evaluate black bishops
+                case b:
+                    // get opening/endgame positional score
+                    score_opening -= positional_score[opening][BISHOP][mirror_score[square]];
+                    score_endgame -= positional_score[endgame][BISHOP][mirror_score[square]];
                     
-                    // evaluate black bishops
-                    case b:
-                        // get opening/endgame positional score
-                        score_opening -= positional_score[opening][BISHOP][mirror_score[square]];
-                        score_endgame -= positional_score[endgame][BISHOP][mirror_score[square]];
-                        
-                        // mobility
-                        score_opening -= (count_bits(get_bishop_attacks(square, occupancies[both])) - bishop_unit) * bishop_mobility_opening;
-                        score_endgame -= (count_bits(get_bishop_attacks(square, occupancies[both])) - bishop_unit) * bishop_mobility_endgame;                    
-                        break;
+                    // mobility
+                    score_opening -= (count_bits(get_bishop_attacks(square, occupancies[both])) - bishop_unit) * bishop_mobility_opening;
+                    score_endgame -= (count_bits(get_bishop_attacks(square, occupancies[both])) - bishop_unit) * bishop_mobility_endgame;                    
+                    break;
+                
+                // evaluate black rooks
+                case r:
+                    // get opening/endgame positional score
+                    score_opening -= positional_score[opening][ROOK][mirror_score[square]];
+                    score_endgame -= positional_score[endgame][ROOK][mirror_score[square]];
                     
-                    // evaluate black rooks
-                    case r:
-                        // get opening/endgame positional score
-                        score_opening -= positional_score[opening][ROOK][mirror_score[square]];
-                        score_endgame -= positional_score[endgame][ROOK][mirror_score[square]];
-                        
-                        // semi open file
-                        if ((bitboards[p] & file_masks[square]) == 0)
-                        {
-                            // add semi open file bonus
-                            score_opening -= semi_open_file_score;
-                            score_endgame -= semi_open_file_score;
-                        }
-                        
-                        // semi open file
-                        if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)
-                        {    
-                            // add semi open file bonus
-                            score_opening -= open_file_score;
-                            score_endgame -= open_file_score;
-                        }
-                        
-                        break;
+                    // semi open file
+                    if (get_bit(pawns->semi_open_files[black], square))
+                    {
+                        // add semi open file bonus
+                        score_opening -= semi_open_file_score;
+                        score_endgame -= semi_open_file_score;
+                    }
                     
-                    // evaluate black queens
-                    case q:
-                        // get opening/endgame positional score
-                        score_opening -= positional_score[opening][QUEEN][mirror_score[square]];
-                        score_endgame -= positional_score[endgame][QUEEN][mirror_score[square]];
-                        
-                        // mobility
-                        score_opening -= (count_bits(get_queen_attacks(square, occupancies[both])) - queen_unit) * queen_mobility_opening;
-                        score_endgame -= (count_bits(get_queen_attacks(square, occupancies[both])) - queen_unit) * queen_mobility_endgame;                    
-                        break;
+                    // semi open file
+                    if (get_bit(open_files, square))
+                    {    
+                        // add semi open file bonus
+                        score_opening -= open_file_score;
+                        score_endgame -= open_file_score;
+                    }
                     
-                    // evaluate black king
-                    case k:
-                        // get opening/endgame positional score
-                        score_opening -= positional_score[opening][KING][mirror_score[square]];
-                        score_endgame -= positional_score[endgame][KING][mirror_score[square]];
-                        
-                        // semi open file
-                        if ((bitboards[p] & file_masks[square]) == 0)
-                        {
-                            // add semi open file penalty
-                            score_opening += semi_open_file_score;
-                            score_endgame += semi_open_file_score;
-                        }
-                        
-                        // semi open file
-                        if (((bitboards[P] | bitboards[p]) & file_masks[square]) == 0)
-                        {
-                            // add semi open file penalty
-                            score_opening += open_file_score;
-                            score_endgame += open_file_score;
-                        }
-                        
-                        // king safety bonus
-                        score_opening -= count_bits(king_attacks[square] & occupancies[black]) * king_shield_bonus;
-                        score_endgame -= count_bits(king_attacks[square] & occupancies[black]) * king_shield_bonus;
-                        break;
-                }
+                    break;
+                
+                // evaluate black queens
+                case q:
+                    // get opening/endgame positional score
+                    score_opening -= positional_score[opening][QUEEN][mirror_score[square]];
+                    score_endgame -= positional_score[endgame][QUEEN][mirror_score[square]];
+                    
+                    // mobility
+                    score_opening -= (count_bits(get_queen_attacks(square, occupancies[both])) - queen_unit) * queen_mobility_opening;
+                    score_endgame -= (count_bits(get_queen_attacks(square, occupancies[both])) - queen_unit) * queen_mobility_endgame;                    
+                    break;
+                
+                // evaluate black king
+                case k:
+                    // get opening/endgame positional score
+                    score_opening -= positional_score[opening][KING][mirror_score[square]];
+                    score_endgame -= positional_score[endgame][KING][mirror_score[square]];
+                    
+                    // semi open file
+                    if (get_bit(pawns->semi_open_files[black], square))
+                    {
+                        // add semi open file penalty
+                        score_opening += semi_open_file_score;
+                        score_endgame += semi_open_file_score;
+                    }
+                    
+                    // semi open file
+                    if (get_bit(open_files, square))
+                    {
+                        // add semi open file penalty
+                        score_opening += open_file_score;
+                        score_endgame += open_file_score;
+                    }
+                    
+                    // king safety bonus
+                    score_opening -= count_bits(king_attacks[square] & occupancies[black]) * king_shield_bonus;
+                    score_endgame -= count_bits(king_attacks[square] & occupancies[black]) * king_shield_bonus;
+                    break;
             }
             
             // pop ls1b
@@ -3440,13 +4294,6 @@ static inline int evaluate()
         }
     }
     
-    // set zero terminating characters at the end of pieces & squares arrays
-    pieces[index] = 0;
-    squares[index] = 0;
-    
-    // get NNUE score (final score! No need to adjust by the side!)
-    int nnue_score = evaluate_nnue(side, pieces, squares);
-    
     /*          
         Now in order to calculate interpolated score
         for a given game phase we use this formula
@@ -3478,11 +4325,197 @@ static inline int evaluate()
     //return (side == white) ? score : -score;
     */
     
-    if (game_phase != endgame)
-        return nnue_score;
+    // return handcrafted endgame score
+    return (side == white) ? score_endgame : -score_endgame;
+}
+
+// position evaluation
+static inline int evaluate()
+{   
+    // get game phase score
+    int game_phase_score = get_game_phase_score();
     
-    else
-        return (side == white) ? score_endgame : -score_endgame;
+    // in the endgame use handcrafted evaluation to speed up engine
+    if (game_phase_score < endgame_phase_score)
+        return evaluate_hce();
+    
+    // current pieces bitboard copy
+    U64 bitboard;
+    
+    // init piece & square
+    int piece, square;
+    
+    // array of piece codes converted to Stockfish piece codes
+    int pieces[33];
+    
+    // array of square indices converted to Stockfish square indices
+    int squares[33];
+    
+    // pieces and squares current index to write next piece square pair at
+    int index = 2;
+    
+    // loop over piece bitboards
+    for (int bb_piece = P; bb_piece <= k; bb_piece++)
+    {
+        // init piece bitboard copy
+        bitboard = bitboards[bb_piece];
+        
+        // loop over pieces within a bitboard
+        while (bitboard)
+        {
+            // init piece
+            piece = bb_piece;
+            
+            // init square
+            square = get_ls1b_index(bitboard);
+            
+            /*
+                Code to initialize pieces and squares arrays
+                to serve the purpose of direct probing of NNUE
+            */
+            
+            // case white king
+            if (piece == K)
+            {
+                /* convert white king piece code to stockfish piece code and
+                   store it at the first index of pieces array
+                */ 
+                pieces[0] = nnue_pieces[piece];
+                
+                /* convert white king square index to stockfish square index and
+                   store it at the first index of pieces array
+                */
+                squares[0] = nnue_squares[square];
+            }
+            
+            // case black king
+            else if (piece == k)
+            {
+                /* convert black king piece code to stockfish piece code and
+                   store it at the second index of pieces array
+                */
+                pieces[1] = nnue_pieces[piece];
+                
+                /* convert black king square index to stockfish square index and
+                   store it at the second index of pieces array
+                */
+                squares[1] = nnue_squares[square];
+            }
+            
+            // all the rest pieces
+            else
+            {
+                /*  convert all the rest of piece code with corresponding square codes
+                    to stockfish piece codes and square indicies respectively
+                */
+                pieces[index] = nnue_pieces[piece];
+                squares[index] = nnue_squares[square];
+                index++;    
+            }
+            
+            // pop ls1b
+            pop_bit(bitboard, square);
+        }
+    }
+    
+    // set zero terminating characters at the end of pieces & squares arrays
+    pieces[index] = 0;
+    squares[index] = 0;
+    
+    // link accumulators from the current ply back to the root ply
+    NNUEdata *nnue[max_ply + 2];
+    
+    // loop over plies
+    for (int ply_count = 0; ply_count <= ply; ply_count++)
+        // current position goes first
+        nnue[ply_count] = &nnue_stack[ply - ply_count];
+    
+    // terminate accumulator list
+    nnue[ply + 1] = NULL;
+    
+    // get NNUE score (final score! No need to adjust by the side!)
+    return evaluate_nnue_incremental(side, pieces, squares, nnue);
+}
+
+// walk the move tree evaluating leaf positions handcrafted way if asked to
+static U64 pawn_bench_walk(int depth, int evaluate_leaves, int *checksum)
+{
+    // leaf position reached
+    if (depth == 0)
+    {
+        // evaluate it
+        if (evaluate_leaves)
+            *checksum += evaluate_hce();
+        
+        return 1;
+    }
+    
+    // leaf positions counter
+    U64 leaves = 0;
+    
+    // create move list instance
+    moves move_list[1];
+    
+    // generate moves
+    generate_moves(move_list);
+    
+    // loop over generated moves
+    for (int move_count = 0; move_count < move_list->count; move_count++)
+    {   
+        // preserve board state
+        copy_board();
+        
+        // make move
+        make_move(move_list->moves[move_count], all_moves);
+        
+        // walk the subtree
+        leaves += pawn_bench_walk(depth - 1, evaluate_leaves, checksum);
+        
+        // take back
+        take_back();
+    }
+    
+    return leaves;
+}
+
+// compare handcrafted evaluation time with and without pawn hash table
+void bench_pawn_table(int depth)
+{
+    int checksum[2] = { 0, 0 };
+    
+    // time spent on tree walk alone and along with evaluations
+    long walk_time, eval_time[2];
+    
+    // time tree walk without evaluations
+    long start = get_time_ms();
+    U64 leaves = pawn_bench_walk(depth, 0, checksum);
+    walk_time = get_time_ms() - start;
+    
+    // time tree walk with evaluations without & with pawn hash table
+    for (use_pawn_table = 0; use_pawn_table <= 1; use_pawn_table++)
+    {
+        // start with empty pawn hash table
+        memset(pawn_table, 0, sizeof(pawn_table));
+        pawn_probes = pawn_hits = 0;
+        
+        start = get_time_ms();
+        pawn_bench_walk(depth, 1, &checksum[use_pawn_table]);
+        eval_time[use_pawn_table] = get_time_ms() - start - walk_time;
+        
+        // no less than a millisecond
+        if (eval_time[use_pawn_table] < 1) eval_time[use_pawn_table] = 1;
+    }
+    
+    // pawn hash table is on by default
+    use_pawn_table = 1;
+    
+    printf("\n     Pawn hash table benchmark\n\n");
+    printf("     Evaluations:      %llu\n", leaves);
+    printf("     Without table:    %ld ms (%.1f ns per eval)\n", eval_time[0], eval_time[0] * 1e6 / leaves);
+    printf("     With table:       %ld ms (%.1f ns per eval)\n", eval_time[1], eval_time[1] * 1e6 / leaves);
+    printf("     Eval time saved:  %.1f%%\n", 100.0 * (eval_time[0] - eval_time[1]) / eval_time[0]);
+    printf("     Hit rate:         %.1f%% (%llu of %llu probes)\n", pawn_probes ? 100.0 * pawn_hits / pawn_probes : 0.0, pawn_hits, pawn_probes);
+    printf("     Scores match:     %s\n\n", checksum[0] == checksum[1] ? "yes" : "no");
 }
 
 
@@ -3535,14 +4568,11 @@ static int mvv_lva[12][12] = {
 	100, 200, 300, 400, 500, 600,  100, 200, 300, 400, 500, 600
 };
 
-// max ply that we can reach within a search
-#define max_ply 64
-
 // killer moves [id][ply]
-int killer_moves[2][max_ply];
+__thread int killer_moves[2][max_ply];
 
 // history moves [piece][square]
-int history_moves[12][64];
+__thread int history_moves[12][64];
 
 /*
       ================================
@@ -3567,26 +4597,103 @@ int history_moves[12][64];
 */
 
 // PV length [ply]
-int pv_length[max_ply];
+__thread int pv_length[max_ply];
 
 // PV table [ply][ply]
-int pv_table[max_ply][max_ply];
+__thread int pv_table[max_ply][max_ply];
 
-// follow PV & score PV move
-int follow_pv, score_pv;
+// follow PV
+__thread int follow_pv;
 
+/*  =======================
+        Search statistics
+    =======================
+    
+    Counters to tune pruning with are compiled in only if
+    SEARCH_STATS is defined (make stats), otherwise count_stat()
+    expands to nothing and they cost nothing.
+*/
 
-/**********************************\
- ==================================
- 
-        Transposition table
- 
- ==================================
-\**********************************/
+#ifdef SEARCH_STATS
+
+// search statistics
+typedef struct {
+    U64 nodes;                  // nodes searched
+    U64 qnodes;                 // quiescence search nodes
+    U64 tt_probes;              // TT probes
+    U64 tt_hits;                // TT probes finding the position
+    U64 tt_cutoffs;             // nodes cut off by TT score
+    U64 null_tries;             // null move searches
+    U64 null_cutoffs;           // null move searches failing high
+    U64 lmr_tries;              // late move reductions
+    U64 lmr_researches;         // reduced searches failing high hence searched again
+    U64 beta_cutoffs;           // beta cutoffs
+    U64 first_move_cutoffs;     // beta cutoffs on the first move searched
+    U64 aspiration_researches;  // iterations falling out of aspiration window
+    U64 depth_nodes[max_ply];   // main thread nodes by the end of iteration [depth]
+} search_stats;
+
+// current thread search statistics
+__thread search_stats stats;
+
+// last search statistics summed over the threads
+search_stats last_search_stats;
+
+// increment search statistics counter
+#define count_stat(counter) (stats.counter++)
+
+#else
+
+// search statistics are compiled out
+#define count_stat(counter)
+
+#endif
+
+// max number of search threads
+#define max_threads 64
+
+// number of search threads (UCI "Threads" option)
+int threads = 1;
+
+// search thread data
+typedef struct {
+    pthread_t handle;       // thread handle
+    int id;                 // thread index (0 is the main thread)
+    int depth;              // depth to search
+    U64 nodes;              // nodes searched so far
+    int best_move;          // best move of the last completed iteration
+    int score;              // score of the last completed iteration
+    int completed_depth;    // last completed iteration depth
+    int ponder_move;        // PV move expected in reply to the best move
+    int best_move_time;     // time the best move was found at (ms)
+    U64 best_move_nodes;    // nodes searched by the time the best move was found
+    #ifdef SEARCH_STATS
+    search_stats stats;     // search statistics
+    #endif
+} search_thread;
+
+// search threads
+search_thread search_threads[max_threads];
+
+
+/**********************************\
+ ==================================
+ 
+        Transposition table
+ 
+ ==================================
+\**********************************/
 
 // number hash table entries
 int hash_entries = 0;
 
+// number of hash table buckets (power of 2) & mask to index them
+U64 hash_buckets = 0;
+U64 hash_mask = 0;
+
+// hash table generation (incremented every search to age older entries)
+unsigned char hash_age = 0;
+
 // no hash entry found constant
 #define no_hash_entry 100000
 
@@ -3595,57 +4702,97 @@ int hash_entries = 0;
 #define hash_flag_alpha 1
 #define hash_flag_beta 2
 
+// number of entries per bucket (4 x 16 bytes fit a 64 bytes cache line)
+#define bucket_size 4
+
+/*
+    TT entry is shared by all the search threads without any locks, so instead
+    of the hash key it stores hash key XOR entry data. If another thread has
+    overwritten half of the entry meanwhile the XOR check simply fails.
+
+          binary data representation                 hexidecimal constants
+    
+    bits  0..23  best move (0 if none)                    0xffffff
+    bits 24..31  depth                                    0xff
+    bits 32..33  flag (fail-low/fail-high/PV)             0x3
+    bits 34..41  age (generation, 0 if empty)             0xff
+    bits 42..61  score + 0x80000                          0xfffff
+*/
+
+// encode TT entry data
+#define encode_hash_data(score, move, depth, flag, age) \
+    (                                                    \
+        (U64)(move) |                                    \
+        ((U64)(depth) << 24) |                           \
+        ((U64)(flag) << 32) |                            \
+        ((U64)(age) << 34) |                             \
+        ((U64)((score) + 0x80000) << 42)                 \
+    )
+
+// extract TT entry data
+#define get_hash_move(data) (int)((data) & 0xffffff)
+#define get_hash_depth(data) (int)(((data) >> 24) & 0xff)
+#define get_hash_flag(data) (int)(((data) >> 32) & 0x3)
+#define get_hash_age(data) (int)(((data) >> 34) & 0xff)
+#define get_hash_score(data) ((int)(((data) >> 42) & 0xfffff) - 0x80000)
+
 // transposition table data structure
 typedef struct {
-    U64 hash_key;   // "almost" unique chess position identifier
-    int depth;      // current search depth
-    int flag;       // flag the type of node (fail-low/fail-high/PV) 
-    int score;      // score (alpha/beta/PV)
-} tt;               // transposition table (TT aka hash table)
+    U64 hash_lock;      // hash key XOR data to verify the position
+    U64 data;           // packed score, best move, depth, flag & age
+} tt;                   // transposition table (TT aka hash table)
+
+// transposition table bucket (exactly one cache line)
+typedef struct {
+    tt entries[bucket_size];    // entries 0..2 are depth-preferred, the last one is always-replace
+} tt_bucket;
+
+// define TT instance (aligned by 64 bytes)
+tt_bucket *hash_table = NULL;
 
-// define TT instance
-tt *hash_table = NULL;
+// dynamically allocated memory the hash table is aligned within
+void *hash_memory = NULL;
 
 // clear TT (hash table)
 void clear_hash_table()
 {
-    // init hash table entry pointer
-    tt *hash_entry;
-
-    // loop over TT elements
-    for (hash_entry = hash_table; hash_entry < hash_table + hash_entries; hash_entry++)
-    {
-        // reset TT inner fields
-        hash_entry->hash_key = 0;
-        hash_entry->depth = 0;
-        hash_entry->flag = 0;
-        hash_entry->score = 0;
-    }
+    // reset all TT entries
+    memset(hash_table, 0, hash_buckets * sizeof(tt_bucket));
+    
+    // reset hash table generation
+    hash_age = 0;
 }
 
 // dynamically allocate memory for hash table
 void init_hash_table(int mb)
 {
     // init hash size
-    int hash_size = 0x100000 * mb;
+    U64 hash_size = 0x100000ULL * mb;
+    
+    // init number of buckets to the largest power of 2 fitting hash size
+    hash_buckets = 1;
+    while (hash_buckets * 2 * sizeof(tt_bucket) <= hash_size) hash_buckets *= 2;
+    
+    // init mask to index hash table buckets
+    hash_mask = hash_buckets - 1;
     
     // init number of hash entries
-    hash_entries =  hash_size / sizeof(tt);
+    hash_entries = hash_buckets * bucket_size;
 
     // free hash table if not empty
-    if (hash_table != NULL)
+    if (hash_memory != NULL)
     {
         printf("    Clearing hash memory...\n");
           
         // free hash table dynamic memory
-        free(hash_table);
+        free(hash_memory);
     }
      
-    // allocate memory
-    hash_table = (tt *) malloc(hash_entries * sizeof(tt));
+    // allocate memory (plus extra space to align the table by a cache line)
+    hash_memory = malloc(hash_buckets * sizeof(tt_bucket) + 63);
 
     // if allocation has failed
-    if (hash_table == NULL)
+    if (hash_memory == NULL)
     {
         printf("    Couldn't allocate memory for hash table, tryinr %dMB...", mb / 2);
         
@@ -3656,6 +4803,9 @@ void init_hash_table(int mb)
     // if allocation succeeded
     else
     {
+        // align hash table by 64 bytes
+        hash_table = (tt_bucket *)(((size_t)hash_memory + 63) & ~(size_t)63);
+        
         // clear hash table
         clear_hash_table();
         
@@ -3665,43 +4815,85 @@ void init_hash_table(int mb)
     
 }
 
+// prefetch hash table bucket for the given hash key into the CPU cache
+static inline void prefetch_hash_entry(U64 key)
+{
+    __builtin_prefetch(&hash_table[key & hash_mask]);
+}
+
+// get hash table usage in permill (sampled over the first 1000 entries)
+int get_hash_full()
+{
+    // number of used entries
+    int used = 0;
+    
+    // loop over the first 1000 entries
+    for (int index = 0; index < 1000 / bucket_size; index++)
+        for (int entry = 0; entry < bucket_size; entry++)
+            // count entries written by the current search
+            if (get_hash_age(hash_table[index].entries[entry].data) == hash_age)
+                used++;
+    
+    // return hash full permill
+    return used;
+}
+
 // read hash entry data
-static inline int read_hash_entry(int alpha, int beta, int depth)
+static inline int read_hash_entry(int alpha, int beta, int *best_move, int depth)
 {
-    // create a TT instance pointer to particular hash entry storing
+    // create a TT instance pointer to particular hash bucket storing
     // the scoring data for the current board position if available
-    tt *hash_entry = &hash_table[hash_key % hash_entries];
+    tt_bucket *bucket = &hash_table[hash_key & hash_mask];
+    
+    // count TT probe
+    count_stat(tt_probes);
     
-    // make sure we're dealing with the exact position we need
-    if (hash_entry->hash_key == hash_key)
+    // loop over bucket entries
+    for (int entry = 0; entry < bucket_size; entry++)
     {
-        // make sure that we match the exact depth our search is now at
-        if (hash_entry->depth >= depth)
+        // read entry data once (other threads may be writing it right now)
+        U64 data = bucket->entries[entry].data;
+        
+        // make sure we're dealing with the exact position we need
+        if ((bucket->entries[entry].hash_lock ^ data) == hash_key && get_hash_age(data))
         {
-            // extract stored score from TT entry
-            int score = hash_entry->score;
-            
-            // retrieve score independent from the actual path
-            // from root node (position) to current node (position)
-            if (score < -mate_score) score += ply;
-            if (score > mate_score) score -= ply;
-        
-            // match the exact (PV node) score 
-            if (hash_entry->flag == hash_flag_exact)
-                // return exact (PV node) score
-                return score;
-            
-            // match alpha (fail-low node) score
-            if ((hash_entry->flag == hash_flag_alpha) &&
-                (score <= alpha))
-                // return alpha (fail-low node) score
-                return alpha;
-            
-            // match beta (fail-high node) score
-            if ((hash_entry->flag == hash_flag_beta) &&
-                (score >= beta))
-                // return beta (fail-high node) score
-                return beta;
+            // count TT hit
+            count_stat(tt_hits);
+            
+            // hash move is useful for move ordering even if the depth is too shallow
+            *best_move = get_hash_move(data);
+            
+            // make sure that we match the exact depth our search is now at
+            if (get_hash_depth(data) >= depth)
+            {
+                // extract stored score from TT entry
+                int score = get_hash_score(data);
+                
+                // retrieve score independent from the actual path
+                // from root node (position) to current node (position)
+                if (score < -mate_score) score += ply;
+                if (score > mate_score) score -= ply;
+            
+                // match the exact (PV node) score 
+                if (get_hash_flag(data) == hash_flag_exact)
+                    // return exact (PV node) score
+                    return score;
+                
+                // match alpha (fail-low node) score
+                if ((get_hash_flag(data) == hash_flag_alpha) &&
+                    (score <= alpha))
+                    // return alpha (fail-low node) score
+                    return alpha;
+                
+                // match beta (fail-high node) score
+                if ((get_hash_flag(data) == hash_flag_beta) &&
+                    (score >= beta))
+                    // return beta (fail-high node) score
+                    return beta;
+            }
+            
+            // position can only be stored once per bucket
+            break;
         }
     }
     
@@ -3710,74 +4902,227 @@ static inline int read_hash_entry(int alpha, int beta, int depth)
 }
 
 // write hash entry data
-static inline void write_hash_entry(int score, int depth, int hash_flag)
+static inline void write_hash_entry(int score, int best_move, int depth, int hash_flag)
 {
-    // create a TT instance pointer to particular hash entry storing
-    // the scoring data for the current board position if available
-    tt *hash_entry = &hash_table[hash_key % hash_entries];
+    // create a TT instance pointer to particular hash bucket storing
+    // the scoring data for the current board position
+    tt_bucket *bucket = &hash_table[hash_key & hash_mask];
+    
+    // entry to write to
+    tt *hash_entry = NULL;
+    
+    // loop over bucket entries
+    for (int entry = 0; entry < bucket_size; entry++)
+    {
+        // read entry data once (other threads may be writing it right now)
+        U64 data = bucket->entries[entry].data;
+        
+        // same position is already stored
+        if ((bucket->entries[entry].hash_lock ^ data) == hash_key && get_hash_age(data))
+        {
+            // overwrite it
+            hash_entry = &bucket->entries[entry];
+            
+            // keep the old hash move if no better move has been found
+            if (best_move == 0) best_move = get_hash_move(data);
+            
+            break;
+        }
+    }
+    
+    // position is not in the bucket yet
+    if (hash_entry == NULL)
+    {
+        // pick up the least valuable depth-preferred entry (entries from older searches go first)
+        tt *replace = &bucket->entries[0];
+        
+        // loop over depth-preferred entries
+        for (int entry = 1; entry < bucket_size - 1; entry++)
+        {
+            // init candidate entry
+            tt *candidate = &bucket->entries[entry];
+            
+            // entries are current if written by the current search
+            int replace_current = get_hash_age(replace->data) == hash_age;
+            int candidate_current = get_hash_age(candidate->data) == hash_age;
+            
+            // stale entry is less valuable than any current one, otherwise compare depths
+            if ((replace_current && !candidate_current) ||
+                (replace_current == candidate_current && get_hash_depth(candidate->data) < get_hash_depth(replace->data)))
+                replace = candidate;
+        }
+        
+        // replace depth-preferred entry if it's stale or not deeper than the new one
+        if (get_hash_age(replace->data) != hash_age || depth >= get_hash_depth(replace->data))
+            hash_entry = replace;
+        
+        // otherwise use the always-replace entry
+        else
+            hash_entry = &bucket->entries[bucket_size - 1];
+    }
 
     // store score independent from the actual path
     // from root node (position) to current node (position)
     if (score < -mate_score) score -= ply;
     if (score > mate_score) score += ply;
 
-    // write hash entry data 
-    hash_entry->hash_key = hash_key;
-    hash_entry->score = score;
-    hash_entry->flag = hash_flag;
-    hash_entry->depth = depth;
+    // pack hash entry data
+    U64 data = encode_hash_data(score, best_move, depth, hash_flag, hash_age);
+    
+    // write hash entry data
+    hash_entry->hash_lock = hash_key ^ data;
+    hash_entry->data = data;
+}
+
+/*  =======================
+     Static exchange eval
+    =======================
+    
+    SEE plays out the sequence of captures on the target square
+    of a capture, each side recapturing with its least valuable
+    attacker (sliders behind the pieces that moved join the fight)
+    and either side being free to stop capturing. The result is
+    negative for captures losing material (the exchange is cut
+    short once its outcome can't change sign any more).
+*/
+
+// static exchange evaluation piece values [piece]
+static const int see_piece_value[12] = {
+    100, 300, 300, 500, 900, 20000,
+    100, 300, 300, 500, 900, 20000
+};
+
+// get pieces of both sides attacking given square assuming given occupancy
+static inline U64 get_square_attackers(int square, U64 occupancy)
+{
+    // bishops & queens, rooks & queens of both sides
+    U64 diagonal_sliders = bitboards[B] | bitboards[b] | bitboards[Q] | bitboards[q];
+    U64 straight_sliders = bitboards[R] | bitboards[r] | bitboards[Q] | bitboards[q];
+    
+    // pawns attack the square the way opposite colored pawns on it would
+    return (pawn_attacks[black][square] & bitboards[P]) |
+           (pawn_attacks[white][square] & bitboards[p]) |
+           (knight_attacks[square] & (bitboards[N] | bitboards[n])) |
+           (king_attacks[square] & (bitboards[K] | bitboards[k])) |
+           (get_bishop_attacks(square, occupancy) & diagonal_sliders) |
+           (get_rook_attacks(square, occupancy) & straight_sliders);
 }
 
-// enable PV move scoring
-static inline void enable_pv_scoring(moves *move_list)
+// static exchange evaluation of a capture
+static inline int see(int move)
 {
-    // disable following PV
-    follow_pv = 0;
+    // init move squares & capturing piece
+    int source_square = get_move_source(move);
+    int target_square = get_move_target(move);
+    int attacker = get_move_piece(move);
     
-    // loop over the moves within a move list
-    for (int count = 0; count < move_list->count; count++)
+    // material balance after each capture of the exchange
+    int gain[32];
+    int depth = 0;
+    
+    // occupancy shrinking as the pieces capture on target square
+    U64 occupancy = occupancies[both];
+    
+    // captured piece, pawn for enpassant captures
+    int victim = P;
+    
+    // enpassant capture removes the pawn behind target square
+    if (get_move_enpassant(move))
+        pop_bit(occupancy, (side == white) ? target_square + 8 : target_square - 8);
+    
+    // otherwise find the captured piece
+    else
     {
-        // make sure we hit PV move
-        if (pv_table[0][ply] == move_list->moves[count])
+        // loop over bitboards opposite to the current side to move
+        for (int bb_piece = (side == white) ? p : P; bb_piece <= ((side == white) ? k : K); bb_piece++)
         {
-            // enable move scoring
-            score_pv = 1;
-            
-            // enable following PV
-            follow_pv = 1;
+            if (get_bit(bitboards[bb_piece], target_square))
+            {
+                victim = bb_piece;
+                break;
+            }
+        }
+    }
+    
+    // first capture wins the victim
+    gain[0] = see_piece_value[victim];
+    
+    // promoted piece is at stake next instead of the pawn
+    if (get_move_promoted(move))
+    {
+        gain[0] += see_piece_value[get_move_promoted(move)] - see_piece_value[P];
+        attacker = get_move_promoted(move);
+    }
+    
+    // all the attackers of target square
+    U64 attackers = get_square_attackers(target_square, occupancy);
+    
+    // piece making the current capture
+    U64 from_bitboard = 1ULL << source_square;
+    
+    // side making the current capture
+    int capturing_side = side;
+    
+    // play out the exchange
+    while (from_bitboard && depth < 31)
+    {
+        depth++;
+        
+        // material balance if the piece on target square gets captured
+        gain[depth] = see_piece_value[attacker] - gain[depth - 1];
+        
+        // neither side can gain anything by going on
+        if ((-gain[depth - 1] > gain[depth] ? -gain[depth - 1] : gain[depth]) < 0)
+            break;
+        
+        // remove the capturing piece & reveal sliders behind it
+        occupancy ^= from_bitboard;
+        attackers = get_square_attackers(target_square, occupancy) & occupancy;
+        
+        // the other side recaptures
+        capturing_side ^= 1;
+        from_bitboard = 0;
+        
+        // with its least valuable attacker
+        for (int bb_piece = (capturing_side == white) ? P : p; bb_piece <= ((capturing_side == white) ? K : k); bb_piece++)
+        {
+            if (attackers & bitboards[bb_piece])
+            {
+                from_bitboard = attackers & bitboards[bb_piece];
+                from_bitboard &= -from_bitboard;
+                attacker = bb_piece;
+                break;
+            }
         }
     }
+    
+    // either side may stop capturing if it's better off (negamax of the gains)
+    while (--depth)
+        gain[depth - 1] = -(-gain[depth - 1] > gain[depth] ? -gain[depth - 1] : gain[depth]);
+    
+    // return material won by the capture
+    return gain[0];
 }
 
 /*  =======================
          Move ordering
     =======================
     
-    1. PV move
-    2. Captures in MVV/LVA
-    3. 1st killer move
-    4. 2nd killer move
-    5. History moves
-    6. Unsorted moves
+    Moves are picked in stages, each stage generates its moves
+    only when it's reached (most nodes cut off on the first move)
+    
+    1. Hash move
+    2. PV move
+    3. Good captures (SEE >= 0) in MVV/LVA
+    4. 1st killer move
+    5. 2nd killer move
+    6. Quiet moves by history
+    7. Bad captures (SEE < 0), quiescence search skips them
 */
 
 // score moves
 static inline int score_move(int move)
 {
-    // if PV move scoring is allowed
-    if (score_pv)
-    {
-        // make sure we are dealing with PV move
-        if (pv_table[0][ply] == move)
-        {
-            // disable score PV flag
-            score_pv = 0;
-            
-            // give PV move the highest score to search it first
-            return 20000;
-        }
-    }
-    
     // score capture move
     if (get_move_capture(move))
     {
@@ -3826,37 +5171,181 @@ static inline int score_move(int move)
     return 0;
 }
 
-// sort moves in descending order
-static inline int sort_moves(moves *move_list)
+// move picker stages
+enum {
+    stage_hash_move, stage_pv_move, stage_init_captures, stage_captures,
+    stage_killer_1, stage_killer_2, stage_init_quiets, stage_quiets, stage_bad_captures,
+    stage_done
+};
+
+// move picker
+typedef struct {
+    moves move_list[1];     // generated moves
+    int move_scores[256];   // scores of generated moves
+    int index;              // next generated move to pick
+    moves bad_captures[1];  // captures losing material deferred after quiet moves
+    int bad_index;          // next bad capture to pick
+    int stage;              // current stage
+    int move_type;          // all moves or only captures (quiescence)
+    int hash_move;          // hash move (0 if none)
+    int pv_move;            // PV move (0 if none)
+    legal_masks masks[1];   // checkers & pinned pieces
+} move_picker;
+
+// init move picker
+static inline void init_move_picker(move_picker *picker, int hash_move, int pv_move, int move_type)
+{
+    picker->move_list->count = 0;
+    picker->index = 0;
+    picker->bad_captures->count = 0;
+    picker->bad_index = 0;
+    picker->stage = stage_hash_move;
+    picker->move_type = move_type;
+    picker->hash_move = hash_move;
+    picker->pv_move = (pv_move != hash_move) ? pv_move : 0;
+    
+    // find checkers & pinned pieces once for all the moves
+    init_legal_masks(picker->masks);
+}
+
+// generate moves of given type and score them
+static inline void generate_picker_moves(move_picker *picker, int move_type)
 {
-    // move scores
-    int move_scores[move_list->count];
+    // first move to score
+    int first = picker->move_list->count;
     
-    // score all the moves within a move list
-    for (int count = 0; count < move_list->count; count++)
-        // score move
-        move_scores[count] = score_move(move_list->moves[count]);
+    // append moves
+    generate_moves_of_type(picker->move_list, move_type, picker->masks);
+    
+    // score moves
+    for (int count = first; count < picker->move_list->count; count++)
+        picker->move_scores[count] = score_move(picker->move_list->moves[count]);
+}
+
+// pick the best scored move left (selection instead of sorting all the moves)
+static inline int pick_best_move(move_picker *picker)
+{
+    // best move index
+    int best = picker->index;
+    
+    // find best score
+    for (int count = picker->index + 1; count < picker->move_list->count; count++)
+        if (picker->move_scores[count] > picker->move_scores[best])
+            best = count;
+    
+    // swap best move with the next one to pick
+    int move = picker->move_list->moves[best];
+    picker->move_list->moves[best] = picker->move_list->moves[picker->index];
+    picker->move_scores[best] = picker->move_scores[picker->index];
+    picker->move_list->moves[picker->index++] = move;
+    
+    return move;
+}
+
+// pick next move (0 if there are no moves left)
+static inline int next_move(move_picker *picker)
+{
+    int move;
     
-    // loop over current move within a move list
-    for (int current_move = 0; current_move < move_list->count; current_move++)
+    switch (picker->stage)
     {
-        // loop over next move within a move list
-        for (int next_move = current_move + 1; next_move < move_list->count; next_move++)
-        {
-            // compare current and next move scores
-            if (move_scores[current_move] < move_scores[next_move])
+        case stage_hash_move:
+            picker->stage = stage_pv_move;
+            
+            // hash move (captures only in quiescence)
+            if (picker->hash_move && (picker->move_type == all_moves || get_move_capture(picker->hash_move)) &&
+                is_pseudo_legal(picker->hash_move) && is_legal(picker->hash_move, picker->masks))
+                return picker->hash_move;
+            
+            picker->hash_move = 0;
+        
+        case stage_pv_move:
+            picker->stage = stage_init_captures;
+            
+            // PV move
+            if (picker->pv_move && is_pseudo_legal(picker->pv_move) && is_legal(picker->pv_move, picker->masks))
+                return picker->pv_move;
+            
+            picker->pv_move = 0;
+        
+        case stage_init_captures:
+            picker->stage = stage_captures;
+            generate_picker_moves(picker, only_captures);
+        
+        case stage_captures:
+            // captures by MVV LVA except for the moves searched already
+            while (picker->index < picker->move_list->count)
             {
-                // swap scores
-                int temp_score = move_scores[current_move];
-                move_scores[current_move] = move_scores[next_move];
-                move_scores[next_move] = temp_score;
+                move = pick_best_move(picker);
+                
+                if (move == picker->hash_move || move == picker->pv_move)
+                    continue;
+                
+                // defer captures losing material (drop them in quiescence search)
+                if (see(move) < 0)
+                {
+                    if (picker->move_type == all_moves)
+                        add_move(picker->bad_captures, move);
+                    
+                    continue;
+                }
                 
-                // swap moves
-                int temp_move = move_list->moves[current_move];
-                move_list->moves[current_move] = move_list->moves[next_move];
-                move_list->moves[next_move] = temp_move;
+                return move;
             }
-        }
+            
+            // quiescence search stops here
+            if (picker->move_type == only_captures)
+            {
+                picker->stage = stage_done;
+                return 0;
+            }
+            
+            picker->stage = stage_killer_1;
+        
+        case stage_killer_1:
+            picker->stage = stage_killer_2;
+            move = killer_moves[0][ply];
+            
+            // 1st killer move
+            if (move && move != picker->hash_move && move != picker->pv_move &&
+                !get_move_capture(move) && is_pseudo_legal(move) && is_legal(move, picker->masks))
+                return move;
+        
+        case stage_killer_2:
+            picker->stage = stage_init_quiets;
+            move = killer_moves[1][ply];
+            
+            // 2nd killer move
+            if (move && move != picker->hash_move && move != picker->pv_move && move != killer_moves[0][ply] &&
+                !get_move_capture(move) && is_pseudo_legal(move) && is_legal(move, picker->masks))
+                return move;
+        
+        case stage_init_quiets:
+            picker->stage = stage_quiets;
+            generate_picker_moves(picker, only_quiets);
+        
+        case stage_quiets:
+            // quiet moves by history except for the moves searched already
+            while (picker->index < picker->move_list->count)
+            {
+                move = pick_best_move(picker);
+                
+                if (move != picker->hash_move && move != picker->pv_move &&
+                    move != killer_moves[0][ply] && move != killer_moves[1][ply])
+                    return move;
+            }
+            
+            picker->stage = stage_bad_captures;
+        
+        case stage_bad_captures:
+            // captures losing material in MVV LVA order
+            if (picker->bad_index < picker->bad_captures->count)
+                return picker->bad_captures->moves[picker->bad_index++];
+            
+            picker->stage = stage_done;
+        
+        default:
+            return 0;
     }
 }
 
@@ -3888,21 +5377,85 @@ static inline int is_repetition()
     return 0;
 }
 
+// nodes count to check if the search has to stop at
+__thread U64 next_check;
+
+// nodes between two checks (adjusted to check the time about every millisecond)
+__thread U64 check_interval;
+
+// time of the last check
+__thread int last_check_time;
+
+// check if the search has to stop (UCI input is handled by the input thread)
+static void check_up()
+{
+    // report nodes searched by a helper thread (main thread's counter is read directly)
+    if (thread_id)
+        search_threads[thread_id].nodes = nodes;
+    
+    // opponent has played the move we ponder on
+    if (thread_id == 0 && pondering && ponderhit)
+    {
+        pondering = 0;
+        
+        // start the clock keeping the iteration going on
+        if (ponder_time != -1)
+        {
+            timeset = 1;
+            starttime = get_time_ms();
+            stoptime = starttime + ponder_time;
+        }
+    }
+    
+    // main thread keeps track of time
+    if (thread_id == 0 && timeset == 1)
+    {
+        // read monotonic clock
+        int current_time = get_time_ms();
+        
+        // if time is up
+        if (current_time > stoptime)
+            // tell engine to stop calculating
+            *stop_flag = 1;
+        
+        // checks are too frequent
+        if (current_time == last_check_time && check_interval < 65536)
+            check_interval *= 2;
+        
+        // checks are too rare
+        else if (current_time - last_check_time > 1 && check_interval > 256)
+            check_interval /= 2;
+        
+        // remember the time of the check
+        last_check_time = current_time;
+    }
+    
+    // schedule next check
+    next_check = nodes + check_interval;
+}
+
 // quiescence search
 static inline int quiescence(int alpha, int beta)
 {
-    // every 2047 nodes
-    if((nodes & 2047 ) == 0)
-        // "listen" to the GUI/user input
-		communicate();
+    // every once in a while
+    if (nodes >= next_check)
+        // check if the time is up
+        check_up();
 	
     // increment nodes count
     nodes++;
+    count_stat(qnodes);
 
     // we are too deep, hence there's an overflow of arrays relying on max ply constant
     if (ply > max_ply - 1)
         // evaluate position
         return evaluate();
+    
+    // best move (to store in TT)
+    int best_move = 0;
+    
+    // read hash move left by a deeper search of this position
+    read_hash_entry(alpha, beta, &best_move, 0);
 
     // evaluate position
     int evaluation = evaluate();
@@ -3921,17 +5474,15 @@ static inline int quiescence(int alpha, int beta)
         alpha = evaluation;
     }
     
-    // create move list instance
-    moves move_list[1];
-    
-    // generate moves
-    generate_moves(move_list);
+    // init move picker for captures
+    move_picker picker[1];
+    init_move_picker(picker, best_move, 0, only_captures);
     
-    // sort moves
-    sort_moves(move_list);
+    // current move
+    int move;
     
-    // loop over moves within a movelist
-    for (int count = 0; count < move_list->count; count++)
+    // loop over captures
+    while ((move = next_move(picker)))
     {
         // preserve board state
         copy_board();
@@ -3944,8 +5495,8 @@ static inline int quiescence(int alpha, int beta)
         repetition_table[repetition_index] = hash_key;
 
         
-        // make sure to make only legal moves
-        if (make_move(move_list->moves[count], only_captures) == 0)
+        // make sure to make only captures
+        if (make_move(move, only_captures) == 0)
         {
             // decrement ply
             ply--;
@@ -3970,7 +5521,7 @@ static inline int quiescence(int alpha, int beta)
         take_back();
         
         // reutrn 0 if time is up
-        if(stopped == 1) return 0;
+        if(*stop_flag == 1) return 0;
         
         // found a better move
         if (score > alpha)
@@ -3991,43 +5542,181 @@ static inline int quiescence(int alpha, int beta)
     return alpha;
 }
 
-// full depth moves counter
-const int full_depth_moves = 4;
+/*  =======================
+         Syzygy tablebases
+    =======================
+    
+    WDL tables are probed in the search right after captures and
+    pawn moves (probes need fifty move counter to be zero), DTZ
+    tables are probed once at the root to leave only the moves
+    keeping the tablebase result. Table files are memory mapped
+    read-only on first use, so processes share their pages.
+*/
 
-// depth limit to consider reduction
-const int reduction_limit = 3;
+// tablebase win score (below mate scores)
+#define tb_win_score 30000
 
-// negamax alpha beta search
-static inline int negamax(int alpha, int beta, int depth)
+// path to Syzygy tablebases (directories separated by ':', ';' on Windows)
+char syzygy_path[max_input_length] = "";
+
+// max number of pieces to probe tablebases for (SyzygyProbeLimit)
+int syzygy_probe_limit = 6;
+
+// max number of pieces to probe tablebases for (0 if no tables are loaded)
+int tb_pieces = 0;
+
+// root moves keeping tablebase result (no filtering if there are none)
+int tb_root_moves[256];
+int tb_root_move_count = 0;
+
+// init tablebases from the given path
+void init_syzygy(char *path)
 {
-    // init PV length
-    pv_length[ply] = ply;
+    // store path
+    strcpy(syzygy_path, path);
     
-    // variable to store current move's score (from the static evaluation perspective)
-    int score;
+    // find available tables (tables are left unloaded for empty path)
+    tb_init(syzygy_path);
+    if (*syzygy_path == '\0') TB_LARGEST = 0;
     
-    // define hash flag
-    int hash_flag = hash_flag_alpha;
+    // probe up to the largest tables available
+    tb_pieces = (int)TB_LARGEST < syzygy_probe_limit ? (int)TB_LARGEST : syzygy_probe_limit;
     
-    // if position repetition occurs
-    if (ply && is_repetition())
-        // return draw score
-        return 0;
+    printf("info string Syzygy tablebases up to %d pieces found\n", TB_LARGEST);
+}
+
+// flip bitboard vertically (tables number squares from a1 instead of a8)
+#define flip_bitboard(bitboard) __builtin_bswap64(bitboard)
+
+// probe WDL tables for the current position (returns TB_RESULT_FAILED if unavailable)
+static inline unsigned probe_wdl()
+{
+    return tb_probe_wdl(flip_bitboard(occupancies[white]), flip_bitboard(occupancies[black]),
+                        flip_bitboard(bitboards[K] | bitboards[k]), flip_bitboard(bitboards[Q] | bitboards[q]),
+                        flip_bitboard(bitboards[R] | bitboards[r]), flip_bitboard(bitboards[B] | bitboards[b]),
+                        flip_bitboard(bitboards[N] | bitboards[n]), flip_bitboard(bitboards[P] | bitboards[p]),
+                        fifty, castle, (enpassant == no_sq) ? 0 : enpassant ^ 56, side == white, hash_key);
+}
+
+// leave only root moves keeping tablebase result for the search
+void filter_tb_root_moves()
+{
+    // search all root moves by default
+    tb_root_move_count = 0;
     
-    // a hack by Pedro Castro to figure out whether the current node is PV node or not 
-    int pv_node = beta - alpha > 1;
+    // position is out of tablebases
+    if (castle || count_bits(occupancies[both]) > tb_pieces)
+        return;
     
-    // read hash entry if we're not in a root ply and hash entry is available
-    // and current node is not a PV node
-    if (ply && (score = read_hash_entry(alpha, beta, depth)) != no_hash_entry && pv_node == 0)
-        // if the move has already been searched (hence has a value)
-        // we just return the score for this move without searching it
-        return score;
-        
-    // every 2047 nodes
-    if((nodes & 2047 ) == 0)
-        // "listen" to the GUI/user input
-		communicate();
+    // tablebase results of legal root moves
+    unsigned results[TB_MAX_MOVES];
+    
+    // probe DTZ tables
+    unsigned result = tb_probe_root(flip_bitboard(occupancies[white]), flip_bitboard(occupancies[black]),
+                                    flip_bitboard(bitboards[K] | bitboards[k]), flip_bitboard(bitboards[Q] | bitboards[q]),
+                                    flip_bitboard(bitboards[R] | bitboards[r]), flip_bitboard(bitboards[B] | bitboards[b]),
+                                    flip_bitboard(bitboards[N] | bitboards[n]), flip_bitboard(bitboards[P] | bitboards[p]),
+                                    fifty, castle, (enpassant == no_sq) ? 0 : enpassant ^ 56, side == white, results);
+    
+    // no tables or game is over
+    if (result == TB_RESULT_FAILED || result == TB_RESULT_CHECKMATE || result == TB_RESULT_STALEMATE)
+        return;
+    
+    // generate root moves
+    moves move_list[1];
+    generate_moves(move_list);
+    
+    // loop over root moves results
+    for (int index = 0; results[index] != TB_RESULT_FAILED; index++)
+    {
+        /* wins & losses: keep the move zeroing fifty move counter fastest (slowest)
+           to make progress, draws: keep every drawing move for the search to choose */
+        if ((TB_GET_WDL(result) == TB_WIN || TB_GET_WDL(result) == TB_LOSS) ?
+            (results[index] & ~TB_RESULT_DTZ_MASK) != (result & ~TB_RESULT_DTZ_MASK) :
+            TB_GET_WDL(results[index]) != TB_GET_WDL(result))
+            continue;
+        
+        // find matching move
+        for (int count = 0; count < move_list->count; count++)
+        {
+            int move = move_list->moves[count];
+            int promoted_piece = get_move_promoted(move);
+            
+            // tables code promotions from queen (1) down to knight (4)
+            if (get_move_source(move) == (TB_GET_FROM(results[index]) ^ 56) &&
+                get_move_target(move) == (TB_GET_TO(results[index]) ^ 56) &&
+                (promoted_piece ? 5 - promoted_piece % 6 : 0) == TB_GET_PROMOTES(results[index]))
+            {
+                tb_root_moves[tb_root_move_count++] = move;
+                break;
+            }
+        }
+    }
+    
+    printf("info string Syzygy root moves kept %d\n", tb_root_move_count);
+}
+
+// check if root move keeps tablebase result
+static inline int is_tb_root_move(int move)
+{
+    for (int index = 0; index < tb_root_move_count; index++)
+        if (tb_root_moves[index] == move)
+            return 1;
+    
+    return 0;
+}
+
+// nodes spent on the best root move in the current iteration (for time management)
+__thread U64 best_root_move_nodes;
+
+// full depth moves counter
+const int full_depth_moves = 4;
+
+// depth limit to consider reduction
+const int reduction_limit = 3;
+
+// negamax alpha beta search
+static inline int negamax(int alpha, int beta, int depth)
+{
+    // init PV length
+    pv_length[ply] = ply;
+    
+    // variable to store current move's score (from the static evaluation perspective)
+    int score;
+    
+    // define hash flag
+    int hash_flag = hash_flag_alpha;
+    
+    // best move (to store in TT)
+    int best_move = 0;
+    
+    // if position repetition occurs
+    if (ply && is_repetition())
+        // return draw score
+        return 0;
+    
+    // a hack by Pedro Castro to figure out whether the current node is PV node or not 
+    int pv_node = beta - alpha > 1;
+    
+    // read hash entry (it also picks up the hash move for move ordering)
+    score = read_hash_entry(alpha, beta, &best_move, depth);
+    
+    // if we're not in a root ply and hash entry is available
+    // and current node is not a PV node
+    if (ply && score != no_hash_entry && pv_node == 0)
+    {
+        // count TT cutoff
+        count_stat(tt_cutoffs);
+        
+        // if the move has already been searched (hence has a value)
+        // we just return the score for this move without searching it
+        return score;
+    }
+        
+    // every once in a while
+    if (nodes >= next_check)
+        // check if the time is up
+        check_up();
 
     // recursion escapre condition
     if (depth == 0)
@@ -4039,6 +5728,24 @@ static inline int negamax(int alpha, int beta, int depth)
         // evaluate position
         return evaluate();
     
+    // probe WDL tables right after captures & pawn moves
+    if (ply && fifty == 0 && castle == 0 && count_bits(occupancies[both]) <= tb_pieces)
+    {
+        // get win/draw/loss
+        unsigned wdl = probe_wdl();
+        
+        // position is in tablebases
+        if (wdl != TB_RESULT_FAILED)
+        {
+            // win & loss scores get closer to zero by ply to prefer faster wins
+            if (wdl == TB_WIN) return tb_win_score - ply;
+            if (wdl == TB_LOSS) return -tb_win_score + ply;
+            
+            // draw, wins & losses drawn by fifty move rule are a bit better or worse than a draw
+            return (int)wdl - TB_DRAW;
+        }
+    }
+    
     // increment nodes count
     nodes++;
     
@@ -4056,6 +5763,9 @@ static inline int negamax(int alpha, int beta, int depth)
     // null move pruning
     if (depth >= 3 && in_check == 0 && ply)
     {
+        // count null move search
+        count_stat(null_tries);
+        
         // preserve board state
         copy_board();
         
@@ -4076,6 +5786,10 @@ static inline int negamax(int alpha, int beta, int depth)
         // switch the side, literally giving opponent an extra move to make
         side ^= 1;
         
+        // null move doesn't change any NNUE features
+        nnue_stack[ply].dirtyPiece.dirtyNum = 0;
+        nnue_stack[ply].accumulator.computedAccumulation = 0;
+        
         // hash the side
         hash_key ^= side_key;
                 
@@ -4093,34 +5807,50 @@ static inline int negamax(int alpha, int beta, int depth)
         take_back();
 
         // reutrn 0 if time is up
-        if(stopped == 1) return 0;
+        if(*stop_flag == 1) return 0;
 
         // fail-hard beta cutoff
         if (score >= beta)
+        {
+            // count null move cutoff
+            count_stat(null_cutoffs);
+            
             // node (position) fails high
             return beta;
+        }
     }
     
-    // create move list instance
-    moves move_list[1];
-    
-    // generate moves
-    generate_moves(move_list);
+    // PV move
+    int pv_move = 0;
     
     // if we are now following PV line
     if (follow_pv)
-        // enable PV move scoring
-        enable_pv_scoring(move_list);
+    {
+        // keep following PV only if PV move is possible in this position
+        pv_move = is_pseudo_legal(pv_table[0][ply]) ? pv_table[0][ply] : 0;
+        follow_pv = pv_move != 0;
+    }
     
-    // sort moves
-    sort_moves(move_list);
+    // init move picker (moves are generated by stages when needed)
+    move_picker picker[1];
+    init_move_picker(picker, best_move, pv_move, all_moves);
+    
+    // current move
+    int move;
     
     // number of moves searched in a move list
     int moves_searched = 0;
     
-    // loop over moves within a movelist
-    for (int count = 0; count < move_list->count; count++)
+    // loop over moves picked one by one
+    while ((move = next_move(picker)))
     {
+        // skip root moves giving tablebase result away
+        if (ply == 0 && tb_root_move_count && !is_tb_root_move(move))
+            continue;
+        
+        // nodes searched before the move
+        U64 nodes_before_move = nodes;
+        
         // preserve board state
         copy_board();
         
@@ -4131,18 +5861,8 @@ static inline int negamax(int alpha, int beta, int depth)
         repetition_index++;
         repetition_table[repetition_index] = hash_key;
         
-        // make sure to make only legal moves
-        if (make_move(move_list->moves[count], all_moves) == 0)
-        {
-            // decrement ply
-            ply--;
-            
-            // decrement repetition index
-            repetition_index--;
-            
-            // skip to next move
-            continue;
-        }
+        // make move
+        make_move(move, all_moves);
         
         // increment legal moves
         legal_moves++;
@@ -4160,11 +5880,17 @@ static inline int negamax(int alpha, int beta, int depth)
                 moves_searched >= full_depth_moves &&
                 depth >= reduction_limit &&
                 in_check == 0 && 
-                get_move_capture(move_list->moves[count]) == 0 &&
-                get_move_promoted(move_list->moves[count]) == 0
+                get_move_capture(move) == 0 &&
+                get_move_promoted(move) == 0
               )
+            {
                 // search current move with reduced depth:
                 score = -negamax(-alpha - 1, -alpha, depth - 2);
+                
+                // count reduction & re-search if reduced search fails high
+                count_stat(lmr_tries);
+                if (score > alpha) count_stat(lmr_researches);
+            }
             
             // hack to ensure that full-depth search is done
             else score = alpha + 1;
@@ -4200,7 +5926,7 @@ static inline int negamax(int alpha, int beta, int depth)
         take_back();
         
         // reutrn 0 if time is up
-        if(stopped == 1) return 0;
+        if(*stop_flag == 1) return 0;
         
         // increment the counter of moves searched so far
         moves_searched++;
@@ -4211,17 +5937,24 @@ static inline int negamax(int alpha, int beta, int depth)
             // switch hash flag from storing score for fail-low node
             // to the one storing score for PV node
             hash_flag = hash_flag_exact;
+            
+            // store best move (for TT)
+            best_move = move;
+            
+            // best root move subtree size (for time management)
+            if (ply == 0)
+                best_root_move_nodes = nodes - nodes_before_move;
         
             // on quiet moves
-            if (get_move_capture(move_list->moves[count]) == 0)
+            if (get_move_capture(move) == 0)
                 // store history moves
-                history_moves[get_move_piece(move_list->moves[count])][get_move_target(move_list->moves[count])] += depth;
+                history_moves[get_move_piece(move)][get_move_target(move)] += depth;
             
             // PV node (position)
             alpha = score;
             
             // write PV move
-            pv_table[ply][ply] = move_list->moves[count];
+            pv_table[ply][ply] = move;
             
             // loop over the next ply
             for (int next_ply = ply + 1; next_ply < pv_length[ply + 1]; next_ply++)
@@ -4234,15 +5967,19 @@ static inline int negamax(int alpha, int beta, int depth)
             // fail-hard beta cutoff
             if (score >= beta)
             {
+                // count beta cutoff (on the first move if move ordering is good)
+                count_stat(beta_cutoffs);
+                if (moves_searched == 1) count_stat(first_move_cutoffs);
+                
                 // store hash entry with the score equal to beta
-                write_hash_entry(beta, depth, hash_flag_beta);
+                write_hash_entry(beta, best_move, depth, hash_flag_beta);
             
                 // on quiet moves
-                if (get_move_capture(move_list->moves[count]) == 0)
+                if (get_move_capture(move) == 0)
                 {
                     // store killer moves
                     killer_moves[1][ply] = killer_moves[0][ply];
-                    killer_moves[0][ply] = move_list->moves[count];
+                    killer_moves[0][ply] = move;
                 }
                 
                 // node (position) fails high
@@ -4251,113 +5988,996 @@ static inline int negamax(int alpha, int beta, int depth)
         }
     }
     
-    // we don't have any legal moves to make in the current postion
-    if (legal_moves == 0)
+    // we don't have any legal moves to make in the current postion
+    if (legal_moves == 0)
+    {
+        // king is in check
+        if (in_check)
+            // return mating score (assuming closest distance to mating position)
+            return -mate_value + ply;
+        
+        // king is not in check
+        else
+            // return stalemate score
+            return 0;
+    }
+    
+    // store hash entry with the score equal to alpha
+    write_hash_entry(alpha, best_move, depth, hash_flag);
+    
+    // node (position) fails low
+    return alpha;
+}
+
+// get nodes searched by all the threads
+U64 get_total_nodes()
+{
+    // nodes searched by the current (main) thread
+    U64 total_nodes = nodes;
+    
+    // add nodes searched by helper threads
+    for (int index = 1; index < threads; index++)
+        total_nodes += search_threads[index].nodes;
+    
+    // return total nodes
+    return total_nodes;
+}
+
+/*
+    Time management: parse_go() sets the optimum time to think for and
+    the hard limit (UCI "stoptime") check_up() stops the search at. After
+    every completed iteration the main thread decides if the next one is
+    worth starting. The optimum is stretched when the best move keeps
+    changing or the score drops and shrunk when most of the nodes go to
+    the best move. The next iteration is not started when the optimum is
+    used up or it's predicted (by the branching factor of the last
+    iterations) to run past the hard limit, so its time isn't wasted on
+    a result thrown away. A single legal move is played right away.
+*/
+
+// count legal moves in the current position
+static int count_legal_moves()
+{
+    // create move list instance
+    moves move_list[1];
+    
+    // generate moves (all of them are legal)
+    generate_moves(move_list);
+    
+    return move_list->count;
+}
+
+// iterative deepening (main thread prints search info)
+void iterative_deepening(search_thread *thread)
+{
+    // search start time
+    int start = get_time_ms();
+    
+    // time management data
+    int root_moves = count_legal_moves();
+    int iteration_start = start, previous_score = 0, best_move_changes = 0;
+    U64 iteration_start_nodes = 0, last_iteration_nodes = 0;
+    double best_move_instability = 0;
+
+    // define best score variable
+    int score = 0;
+    
+    // reset nodes counter
+    nodes = 0;
+    
+    // reset search statistics
+    #ifdef SEARCH_STATS
+    memset(&stats, 0, sizeof(stats));
+    #endif
+    
+    // init checks if the search has to stop
+    check_interval = 1024;
+    next_check = check_interval;
+    last_check_time = start;
+    
+    // reset follow PV flag
+    follow_pv = 0;
+    
+    // clear helper data structures for search
+    memset(killer_moves, 0, sizeof(killer_moves));
+    memset(history_moves, 0, sizeof(history_moves));
+    memset(pv_table, 0, sizeof(pv_table));
+    memset(pv_length, 0, sizeof(pv_length));
+    
+    // evaluate root position to init NNUE accumulator the search is going to update
+    evaluate();
+    
+    // define initial alpha beta bounds
+    int alpha = -infinity;
+    int beta = infinity;
+ 
+    // iterative deepening (odd helper threads start one ply deeper to diversify the search)
+    for (int current_depth = 1 + (thread->id & 1); current_depth <= thread->depth; current_depth++)
+    {
+        // if time is up
+        if(*stop_flag == 1)
+			// stop calculating and return best move so far 
+			break;
+		
+        // enable follow PV flag
+        follow_pv = 1;
+        
+        // find best move within a given position
+        score = negamax(alpha, beta, current_depth);
+ 
+        // we fell outside the window, so try again with a full-width window (and the same depth)
+        if ((score <= alpha) || (score >= beta)) {
+            count_stat(aspiration_researches);
+            alpha = -infinity;    
+            beta = infinity;      
+            continue;
+        }
+        
+        // store nodes searched by the end of iteration
+        #ifdef SEARCH_STATS
+        stats.depth_nodes[current_depth] = nodes;
+        #endif
+        
+        // set up the window for the next iteration
+        alpha = score - 50;
+        beta = score + 50;
+        
+        // store the result of completed iteration to vote for the best move
+        if (*stop_flag == 0 && pv_length[0])
+        {
+            // remember when the best move was found
+            if (thread->best_move != pv_table[0][0])
+            {
+                thread->best_move_time = get_time_ms() - start;
+                thread->best_move_nodes = nodes;
+                
+                // count best move changes
+                if (thread->best_move) best_move_changes++;
+            }
+            
+            thread->best_move = pv_table[0][0];
+            thread->ponder_move = pv_length[0] > 1 ? pv_table[0][1] : 0;
+            thread->score = score;
+            thread->completed_depth = current_depth;
+        }
+        
+        // if PV is available
+        if (pv_length[0] && thread->id == 0 && !quiet_search)
+        {
+            // print search info
+            if (score > -mate_value && score < -mate_score)
+                printf("info score mate %d depth %d nodes %lld hashfull %d time %d pv ", -(score + mate_value) / 2 - 1, current_depth, get_total_nodes(), get_hash_full(), get_time_ms() - start);
+            
+            else if (score > mate_score && score < mate_value)
+                printf("info score mate %d depth %d nodes %lld hashfull %d time %d pv ", (mate_value - score) / 2 + 1, current_depth, get_total_nodes(), get_hash_full(), get_time_ms() - start);   
+            
+            else
+                printf("info score cp %d depth %d nodes %lld hashfull %d time %d pv ", score, current_depth, get_total_nodes(), get_hash_full(), get_time_ms() - start);
+            
+            // loop over the moves within a PV line
+            for (int count = 0; count < pv_length[0]; count++)
+            {
+                // print PV move
+                print_move(pv_table[0][count]);
+                printf(" ");
+            }
+            
+            // print new line
+            printf("\n");
+        }
+        
+        // main thread decides whether to start the next iteration
+        if (thread->id == 0 && timeset == 1 && optimum_time != -1 && *stop_flag == 0)
+        {
+            int current_time = get_time_ms();
+            
+            // time & nodes spent on the iteration
+            int iteration_time = current_time - iteration_start;
+            U64 iteration_nodes = nodes - iteration_start_nodes;
+            
+            // best move changes (older ones matter less)
+            best_move_instability = best_move_instability / 2 + best_move_changes;
+            best_move_changes = 0;
+            
+            // stretch optimum time for unstable best move
+            double scale = 1.0 + best_move_instability / 2;
+            
+            // stretch optimum time for falling score (up to twice)
+            int score_drop = current_depth > 1 ? previous_score - score : 0;
+            if (score_drop > 0) scale *= 1.0 + (score_drop < 100 ? score_drop : 100) / 100.0;
+            
+            // shrink optimum time when the best move takes most of the nodes
+            if (best_root_move_nodes > iteration_nodes * 0.9 && best_move_instability < 0.1) scale /= 2;
+            
+            // time the next iteration is expected to take (by the branching factor)
+            double branching_factor = last_iteration_nodes ? (double)iteration_nodes / last_iteration_nodes : 3.0;
+            if (branching_factor < 1.5) branching_factor = 1.5;
+            if (branching_factor > 8.0) branching_factor = 8.0;
+            int predicted_time = iteration_time * branching_factor;
+            
+            // time used & optimum time scaled
+            int elapsed = current_time - starttime;
+            int budget = optimum_time * scale;
+            
+            // stop on a single legal move, when time is over or the next iteration can't finish in time
+            if (root_moves == 1 || elapsed >= budget || elapsed + predicted_time > 2 * budget || current_time + predicted_time > stoptime)
+                break;
+            
+            // next iteration starts here
+            iteration_start = current_time;
+            iteration_start_nodes = nodes;
+            last_iteration_nodes = iteration_nodes;
+            previous_score = score;
+        }
+    }
+    
+    // report nodes searched by the current thread
+    thread->nodes = nodes;
+    
+    // report search statistics of the current thread
+    #ifdef SEARCH_STATS
+    stats.nodes = nodes;
+    thread->stats = stats;
+    #endif
+}
+
+// root position helper threads start searching from
+U64 root_bitboards[12];
+U64 root_occupancies[3];
+int root_side, root_enpassant, root_castle, root_fifty;
+U64 root_hash_key, root_pawn_key;
+U64 root_repetition_table[1000];
+int root_repetition_index;
+
+// helper thread search
+void *helper_search(void *arg)
+{
+    // init search thread data
+    search_thread *thread = (search_thread *)arg;
+    
+    // init thread index
+    thread_id = thread->id;
+    
+    // copy root position to the thread's board
+    memcpy(bitboards, root_bitboards, sizeof(bitboards));
+    memcpy(occupancies, root_occupancies, sizeof(occupancies));
+    memcpy(repetition_table, root_repetition_table, sizeof(repetition_table));
+    side = root_side;
+    enpassant = root_enpassant;
+    castle = root_castle;
+    fifty = root_fifty;
+    hash_key = root_hash_key;
+    pawn_key = root_pawn_key;
+    repetition_index = root_repetition_index;
+    ply = 0;
+    
+    // search the position
+    iterative_deepening(thread);
+    
+    // terminate thread
+    return NULL;
+}
+
+// pick up the best move voted by search threads weighted by depth and score
+int vote_best_move()
+{
+    // lowest score among the threads
+    int min_score = search_threads[0].score;
+    
+    // loop over threads
+    for (int index = 1; index < threads; index++)
+        // update lowest score
+        if (search_threads[index].score < min_score)
+            min_score = search_threads[index].score;
+    
+    // best move & its votes
+    int best_move = search_threads[0].best_move;
+    long long best_votes = -1;
+    
+    // loop over threads' best moves
+    for (int index = 0; index < threads; index++)
+    {
+        // skip threads that have not completed any iteration
+        if (search_threads[index].best_move == 0) continue;
+        
+        // votes for the current move
+        long long votes = 0;
+        
+        // sum up votes from all the threads agreeing on the move
+        for (int voter = 0; voter < threads; voter++)
+            if (search_threads[voter].best_move == search_threads[index].best_move)
+                votes += (long long)(search_threads[voter].score - min_score + 14) * search_threads[voter].completed_depth;
+        
+        // found move with more votes
+        if (votes > best_votes)
+        {
+            best_votes = votes;
+            best_move = search_threads[index].best_move;
+        }
+    }
+    
+    // return the most voted move
+    return best_move;
+}
+
+#ifdef SEARCH_STATS
+
+// percentage of a counter in its total (0 if there are none)
+static double stats_rate(U64 count, U64 total)
+{
+    return total ? 100.0 * count / total : 0.0;
+}
+
+// sum up search statistics of the threads
+void collect_search_stats()
+{
+    search_stats *total = &last_search_stats;
+    
+    memset(total, 0, sizeof(search_stats));
+    
+    // loop over search threads
+    for (int index = 0; index < threads; index++)
+    {
+        search_stats *s = &search_threads[index].stats;
+        
+        total->nodes += s->nodes;
+        total->qnodes += s->qnodes;
+        total->tt_probes += s->tt_probes;
+        total->tt_hits += s->tt_hits;
+        total->tt_cutoffs += s->tt_cutoffs;
+        total->null_tries += s->null_tries;
+        total->null_cutoffs += s->null_cutoffs;
+        total->lmr_tries += s->lmr_tries;
+        total->lmr_researches += s->lmr_researches;
+        total->beta_cutoffs += s->beta_cutoffs;
+        total->first_move_cutoffs += s->first_move_cutoffs;
+        total->aspiration_researches += s->aspiration_researches;
+    }
+    
+    // helper threads start at different depths, so branching factor is main thread's
+    memcpy(total->depth_nodes, search_threads[0].stats.depth_nodes, sizeof(total->depth_nodes));
+}
+
+// print last search statistics
+void print_search_stats()
+{
+    search_stats *s = &last_search_stats;
+    
+    printf("info string stats nodes %llu qnodes %llu (%.1f%%)\n",
+           s->nodes, s->qnodes, stats_rate(s->qnodes, s->nodes));
+    printf("info string stats tt probes %llu hits %llu (%.1f%%) cutoffs %llu (%.1f%%)\n",
+           s->tt_probes, s->tt_hits, stats_rate(s->tt_hits, s->tt_probes), s->tt_cutoffs, stats_rate(s->tt_cutoffs, s->tt_probes));
+    printf("info string stats null move tries %llu cutoffs %llu (%.1f%%)\n",
+           s->null_tries, s->null_cutoffs, stats_rate(s->null_cutoffs, s->null_tries));
+    printf("info string stats lmr reductions %llu re-searches %llu (%.1f%%)\n",
+           s->lmr_tries, s->lmr_researches, stats_rate(s->lmr_researches, s->lmr_tries));
+    printf("info string stats beta cutoffs %llu on first move %llu (%.1f%%)\n",
+           s->beta_cutoffs, s->first_move_cutoffs, stats_rate(s->first_move_cutoffs, s->beta_cutoffs));
+    printf("info string stats aspiration re-searches %llu\n", s->aspiration_researches);
+    
+    // nodes of the previous completed iteration
+    U64 previous_nodes = 0;
+    
+    // branching factor (nodes of the iteration over nodes of the previous one)
+    printf("info string stats branching factor");
+    
+    for (int depth = 1; depth < max_ply; depth++)
+    {
+        // skip iterations not completed
+        if (s->depth_nodes[depth] == 0) continue;
+        
+        if (previous_nodes)
+            printf(" %d:%.2f", depth, (double)s->depth_nodes[depth] / previous_nodes);
+        
+        previous_nodes = s->depth_nodes[depth];
+    }
+    
+    printf("\n");
+}
+
+#endif
+
+// search position for the best move
+void search_position(int depth)
+{
+    // let UCI input thread know the search is running
+    searching = 1;
+    
+    // start new hash table generation (0 stands for an empty entry)
+    if (++hash_age == 0) hash_age = 1;
+    
+    // store root position for helper threads
+    memcpy(root_bitboards, bitboards, sizeof(bitboards));
+    memcpy(root_occupancies, occupancies, sizeof(occupancies));
+    memcpy(root_repetition_table, repetition_table, sizeof(repetition_table));
+    root_side = side;
+    root_enpassant = enpassant;
+    root_castle = castle;
+    root_fifty = fifty;
+    root_hash_key = hash_key;
+    root_pawn_key = pawn_key;
+    root_repetition_index = repetition_index;
+    
+    // leave only root moves keeping tablebase result
+    filter_tb_root_moves();
+    
+    // loop over search threads
+    for (int index = 0; index < threads; index++)
+    {
+        // reset search thread data
+        memset(&search_threads[index], 0, sizeof(search_thread));
+        search_threads[index].id = index;
+        search_threads[index].depth = depth;
+    }
+    
+    // start helper threads
+    for (int index = 1; index < threads; index++)
+        pthread_create(&search_threads[index].handle, NULL, helper_search, &search_threads[index]);
+    
+    // main thread search
+    iterative_deepening(&search_threads[0]);
+    
+    // don't report the best move before "stop" or "ponderhit" when pondering or searching infinitely
+    while (infinite && !stopped)
+        usleep(1000);
+    
+    // stop helper threads
+    stopped = 1;
+    
+    // wait for helper threads to finish
+    for (int index = 1; index < threads; index++)
+        pthread_join(search_threads[index].handle, NULL);
+    
+    // best move
+    int best_move = pv_table[0][0];
+    
+    // let the threads vote for the best move
+    if (threads > 1) best_move = vote_best_move();
+    
+    // sum up & print search statistics
+    #ifdef SEARCH_STATS
+    collect_search_stats();
+    if (!quiet_search) print_search_stats();
+    #endif
+    
+    // search is over
+    searching = 0;
+    
+    // store best move
+    last_best_move = best_move;
+    
+    // bench reports best moves itself
+    if (quiet_search) return;
+    
+    // print best move
+    printf("bestmove ");
+    print_move(best_move);
+    
+    // print move to ponder on from PV of a thread agreeing on the best move
+    for (int index = 0; index < threads; index++)
+    {
+        if (search_threads[index].best_move == best_move && search_threads[index].ponder_move)
+        {
+            printf(" ponder ");
+            print_move(search_threads[index].ponder_move);
+            break;
+        }
+    }
+    
+    printf("\n");
+}
+
+
+/**********************************\
+ ==================================
+ 
+               Bench
+ 
+ ==================================
+\**********************************/
+
+/*
+    Bench searches a fixed set of positions to a fixed depth starting
+    from a cleared hash table. Single threaded search of the same build
+    visits the same number of nodes every time, so the total node count
+    serves as a signature of the search: a change that is meant to only
+    speed things up must leave it intact, a change to the search shows
+    up as a new signature. Built-in positions are followed by the hard
+    positions collection of the repository if it's found.
+*/
+
+// built-in bench positions
+char *bench_positions[] = {
+    start_position,
+    tricky_position,
+    cmk_position,
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1 ",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1 ",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8 ",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10 ",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16 ",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19 ",
+    "2r3k1/pp3ppp/4p3/3pP3/3P4/P4N2/1P3PPP/2R3K1 b - - 3 24 ",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1 ",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1 ",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1 ",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1 "
+};
+
+// number of built-in bench positions
+#define bench_position_count (int)(sizeof(bench_positions) / sizeof(bench_positions[0]))
+
+// hard positions collection (relative to the engine directory)
+#define bench_fen_file "../../../fen/talkchess_hard_fen.txt"
+
+// search a single bench position, return nodes searched
+static U64 bench_position(char *fen, int depth, int number)
+{
+    // init position & search from scratch
+    parse_fen(fen);
+    clear_hash_table();
+    
+    // no time control
+    timeset = 0;
+    stopped = 0;
+    
+    // search position to the fixed depth
+    search_position(depth);
+    
+    // nodes searched by all the threads
+    U64 position_nodes = get_total_nodes();
+    
+    printf("     %3d  %12llu  ", number, position_nodes);
+    print_move(last_best_move);
+    printf("\n");
+    
+    return position_nodes;
+}
+
+// search bench positions to the given depth, print total nodes, time & NPS
+void bench(int depth, int mb, int thread_count)
+{
+    // total nodes searched
+    U64 total_nodes = 0;
+    
+    // positions searched
+    int count = 0;
+    
+    // adjust arguments if going beyond the allowed bounds
+    if (depth < 1) depth = 1;
+    if (depth > 64) depth = 64;
+    if (mb < 4) mb = 4;
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > max_threads) thread_count = max_threads;
+    
+    // init hash table size & number of threads to bench with
+    init_hash_table(mb);
+    threads = thread_count;
+    
+    printf("\n     Bench: depth %d, hash %dMB, threads %d\n\n", depth, mb, threads);
+    printf("       #         nodes  best move\n\n");
+    
+    // suppress search info output
+    quiet_search = 1;
+    
+    long start = get_time_ms();
+    
+    // search built-in positions
+    for (int index = 0; index < bench_position_count; index++)
+        total_nodes += bench_position(bench_positions[index], depth, ++count);
+    
+    // open hard positions collection
+    FILE *file = fopen(bench_fen_file, "r");
+    
+    // search hard positions (EPD operations after the FEN fields are ignored)
+    if (file)
+    {
+        char line[max_input_length];
+        
+        while (fgets(line, sizeof(line), file))
+        {
+            // skip empty lines
+            if (line[0] == '\n' || line[0] == '\r' || line[0] == '\0') continue;
+            
+            total_nodes += bench_position(line, depth, ++count);
+        }
+        
+        fclose(file);
+    }
+    
+    else
+        printf("     %s not found, built-in positions only\n", bench_fen_file);
+    
+    long time = get_time_ms() - start;
+    
+    // no less than a millisecond
+    if (time < 1) time = 1;
+    
+    // restore search info output
+    quiet_search = 0;
+    
+    printf("\n     Positions:  %d\n", count);
+    printf("     Nodes:      %llu\n", total_nodes);
+    printf("     Time:       %ld ms\n", time);
+    printf("     NPS:        %llu\n\n", total_nodes * 1000 / time);
+}
+
+
+/**********************************\
+ ==================================
+ 
+             EPD suites
+ 
+ ==================================
+\**********************************/
+
+/*
+    EPD runner searches the positions of a test suite for a fixed time
+    each and checks the best move against "bm" (best move) and "am"
+    (avoid move) operations. Positions are spread over worker threads,
+    every worker searches its own position on its own board with its
+    own time limit & stop flag while sharing the hash table. A position
+    counts as solved when the final best move is among "bm" moves (and
+    not among "am" ones); time & nodes to solution are taken at the
+    iteration the final best move was found at.
+*/
+
+// max number of "bm" or "am" moves per position
+#define max_epd_moves 8
+
+// EPD test position
+typedef struct {
+    char fen[128];                          // FEN fields of the position
+    char id[64];                            // "id" operation
+    char best_san[64];                      // "bm" operation as given
+    char avoid_san[64];                     // "am" operation as given
+    int best_moves[max_epd_moves];          // "bm" moves
+    int best_count;
+    int avoid_moves[max_epd_moves];         // "am" moves
+    int avoid_count;
+    search_thread result;                   // search result
+    int solved;                             // best move is correct
+} epd_position;
+
+// test suite positions
+epd_position *epd_positions = NULL;
+int epd_position_count = 0;
+int epd_position_capacity = 0;
+
+// next position to take & time to search each position for
+atomic_int epd_next_position;
+int epd_movetime;
+
+// parse move in SAN (e.g. "Nbxd7+", "exd8=Q", "O-O") for the current position, 0 if illegal
+int parse_san(char *san)
+{
+    // SAN without check/annotation symbols
+    char text[16];
+    int length = 0;
+    
+    while (san[length] && length < 15 && !strchr("+#!?", san[length]))
+    {
+        text[length] = san[length];
+        length++;
+    }
+    
+    text[length] = '\0';
+    
+    // piece type (pawn by default), promoted piece type & squares
+    int piece = P, promoted = 0, source_file = -1, source_rank = -1, target_square;
+    
+    // castling is king move to the castling square
+    if (!strncmp(text, "O-O", 3) || !strncmp(text, "0-0", 3))
+    {
+        piece = K;
+        target_square = (length == 5 ? c1 : g1) - (side == black ? 56 : 0);
+    }
+    
+    else
+    {
+        // piece letter
+        char *piece_letter = strchr("NBRQK", text[0]);
+        
+        if (text[0] && piece_letter)
+            piece = piece_letter - "NBRQK" + N;
+        
+        // promoted piece letter (after "=" or right after the target square)
+        if (length && strchr("NBRQ", text[length - 1]) && piece == P)
+        {
+            promoted = strchr("NBRQ", text[length - 1]) - "NBRQ" + N;
+            length -= (length > 1 && text[length - 2] == '=') ? 2 : 1;
+        }
+        
+        // target square is the last file & rank
+        if (length < 2 || text[length - 2] < 'a' || text[length - 2] > 'h' ||
+            text[length - 1] < '1' || text[length - 1] > '8')
+            return 0;
+        
+        target_square = (text[length - 2] - 'a') + (8 - (text[length - 1] - '0')) * 8;
+        
+        // source file or rank given to disambiguate the move
+        for (int index = (piece == P) ? 0 : 1; index < length - 2; index++)
+        {
+            if (text[index] >= 'a' && text[index] <= 'h') source_file = text[index] - 'a';
+            if (text[index] >= '1' && text[index] <= '8') source_rank = 8 - (text[index] - '0');
+        }
+    }
+    
+    // create move list instance
+    moves move_list[1];
+    
+    // generate moves
+    generate_moves(move_list);
+    
+    // loop over generated moves
+    for (int move_count = 0; move_count < move_list->count; move_count++)
+    {
+        int move = move_list->moves[move_count];
+        int source_square = get_move_source(move);
+        
+        // match move with SAN
+        if (get_move_piece(move) % 6 != piece || get_move_target(move) != target_square ||
+            (get_move_promoted(move) ? get_move_promoted(move) % 6 : 0) != promoted ||
+            (source_file != -1 && source_square % 8 != source_file) ||
+            (source_rank != -1 && source_square / 8 != source_rank))
+            continue;
+        
+        // generated moves are legal
+        return move;
+    }
+    
+    // no legal move matches SAN
+    return 0;
+}
+
+// parse space separated SAN moves of EPD operation for the current position
+static int parse_epd_moves(char *operation, int *move_list)
+{
+    int count = 0;
+    char san[16];
+    int length;
+    
+    // loop over SAN moves
+    while (count < max_epd_moves && sscanf(operation, " %15s%n", san, &length) == 1)
+    {
+        operation += length;
+        
+        // keep legal moves only
+        if ((move_list[count] = parse_san(san)))
+            count++;
+        
+        else
+            printf("info string illegal EPD move %s\n", san);
+    }
+    
+    return count;
+}
+
+// parse EPD line (FEN fields followed by operations separated by ';'), 0 if there's no position
+static int parse_epd(char *line, epd_position *position)
+{
+    memset(position, 0, sizeof(epd_position));
+    
+    // skip FEN fields: placement, side, castling & en passant
+    char *operations = line;
+    
+    for (int field = 0; field < 4; field++)
+    {
+        while (*operations == ' ') operations++;
+        if (*operations == '\0' || *operations == '\n') return 0;
+        while (*operations && *operations != ' ' && *operations != '\n') operations++;
+    }
+    
+    // store FEN fields
+    int fen_length = operations - line < 127 ? operations - line : 127;
+    strncpy(position->fen, line, fen_length);
+    position->fen[fen_length] = '\0';
+    
+    // init board to parse moves for
+    parse_fen(position->fen);
+    
+    // loop over operations
+    char *operation = strtok(operations, ";\r\n");
+    
+    while (operation)
     {
-        // king is in check
-        if (in_check)
-            // return mating score (assuming closest distance to mating position)
-            return -mate_value + ply;
+        // skip leading spaces
+        while (*operation == ' ') operation++;
         
-        // king is not in check
-        else
-            // return stalemate score
-            return 0;
+        // best moves
+        if (!strncmp(operation, "bm ", 3))
+        {
+            snprintf(position->best_san, sizeof(position->best_san), "%s", operation + 3);
+            position->best_count = parse_epd_moves(operation + 3, position->best_moves);
+        }
+        
+        // moves to avoid
+        else if (!strncmp(operation, "am ", 3))
+        {
+            snprintf(position->avoid_san, sizeof(position->avoid_san), "%s", operation + 3);
+            position->avoid_count = parse_epd_moves(operation + 3, position->avoid_moves);
+        }
+        
+        // position identifier (without quotes)
+        else if (!strncmp(operation, "id ", 3))
+        {
+            char *id = operation + 3;
+            if (*id == '"') id++;
+            snprintf(position->id, sizeof(position->id), "%s", id);
+            position->id[strcspn(position->id, "\"")] = '\0';
+        }
+        
+        operation = strtok(NULL, ";\r\n");
     }
     
-    // store hash entry with the score equal to alpha
-    write_hash_entry(alpha, depth, hash_flag);
+    return 1;
+}
+
+// check if move is in the list
+static int is_epd_move(int move, int *move_list, int count)
+{
+    for (int index = 0; index < count; index++)
+        if (move_list[index] == move)
+            return 1;
     
-    // node (position) fails low
-    return alpha;
+    return 0;
 }
 
-// search position for the best move
-void search_position(int depth)
+// EPD worker thread (current thread works on positions as well)
+void *epd_worker(void *arg)
 {
-    // search start time
-    int start = get_time_ms();
+    // own stop flag
+    atomic_int position_stopped;
+    stop_flag = &position_stopped;
+    
+    int index;
+    
+    // take positions until there are no more left
+    while (!quit && (index = atomic_fetch_add(&epd_next_position, 1)) < epd_position_count)
+    {
+        epd_position *position = &epd_positions[index];
+        
+        // init position
+        parse_fen(position->fen);
+        
+        // init own time limit
+        position_stopped = 0;
+        timeset = 1;
+        stoptime = get_time_ms() + epd_movetime;
+        
+        // search position
+        position->result.depth = max_ply;
+        iterative_deepening(&position->result);
+        
+        // check the best move
+        position->solved = (position->best_count == 0 || is_epd_move(position->result.best_move, position->best_moves, position->best_count)) &&
+                           !is_epd_move(position->result.best_move, position->avoid_moves, position->avoid_count);
+    }
+    
+    // restore UCI stop flag & time control
+    stop_flag = &stopped;
+    timeset = 0;
+    
+    return NULL;
+}
 
-    // define best score variable
-    int score = 0;
+// run EPD test suite, print results per position in CSV
+void run_epd(char *file_name, int movetime, int thread_count)
+{
+    // open test suite
+    FILE *file = fopen(file_name, "r");
     
-    // reset nodes counter
-    nodes = 0;
+    if (file == NULL)
+    {
+        printf("info string unable to open %s\n", file_name);
+        return;
+    }
     
-    // reset "time is up" flag
-    stopped = 0;
+    // adjust arguments if going beyond the allowed bounds
+    if (movetime < 1) movetime = 1;
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > max_threads) thread_count = max_threads;
     
-    // reset follow PV flags
-    follow_pv = 0;
-    score_pv = 0;
+    // read positions
+    char line[max_input_length];
+    epd_position_count = 0;
     
-    // clear helper data structures for search
-    memset(killer_moves, 0, sizeof(killer_moves));
-    memset(history_moves, 0, sizeof(history_moves));
-    memset(pv_table, 0, sizeof(pv_table));
-    memset(pv_length, 0, sizeof(pv_length));
+    while (fgets(line, sizeof(line), file))
+    {
+        // grow positions array
+        if (epd_position_count == epd_position_capacity)
+        {
+            epd_position_capacity = epd_position_capacity ? epd_position_capacity * 2 : 256;
+            epd_positions = realloc(epd_positions, epd_position_capacity * sizeof(epd_position));
+        }
+        
+        if (parse_epd(line, &epd_positions[epd_position_count]))
+            epd_position_count++;
+    }
     
-    // define initial alpha beta bounds
-    int alpha = -infinity;
-    int beta = infinity;
- 
-    // iterative deepening
-    for (int current_depth = 1; current_depth <= depth; current_depth++)
+    fclose(file);
+    
+    printf("info string %d positions, movetime %d ms, %d jobs\n", epd_position_count, movetime, thread_count);
+    
+    // search all root moves, start with empty hash table
+    tb_root_move_count = 0;
+    clear_hash_table();
+    
+    // suppress search info output
+    quiet_search = 1;
+    
+    // init positions queue
+    epd_movetime = movetime;
+    epd_next_position = 0;
+    
+    long start = get_time_ms();
+    
+    // start worker threads
+    pthread_t handles[thread_count];
+    
+    for (int index = 1; index < thread_count; index++)
+        pthread_create(&handles[index], NULL, epd_worker, NULL);
+    
+    // work on positions in current thread as well
+    epd_worker(NULL);
+    
+    // wait for worker threads
+    for (int index = 1; index < thread_count; index++)
+        pthread_join(handles[index], NULL);
+    
+    long time = get_time_ms() - start;
+    
+    // restore search info output
+    quiet_search = 0;
+    
+    // solved positions, time & nodes to solution
+    int solved = 0;
+    long solution_time = 0;
+    U64 solution_nodes = 0;
+    
+    // print results
+    printf("id,bm,am,move,solved,depth,time,nodes\n");
+    
+    for (int index = 0; index < epd_position_count; index++)
     {
-        // if time is up
-        if(stopped == 1)
-			// stop calculating and return best move so far 
-			break;
-		
-        // enable follow PV flag
-        follow_pv = 1;
+        epd_position *position = &epd_positions[index];
+        int move = position->result.best_move;
         
-        // find best move within a given position
-        score = negamax(alpha, beta, current_depth);
- 
-        // we fell outside the window, so try again with a full-width window (and the same depth)
-        if ((score <= alpha) || (score >= beta)) {
-            alpha = -infinity;    
-            beta = infinity;      
-            continue;
-        }
+        // best move in UCI format
+        char move_string[6] = "0000";
         
-        // set up the window for the next iteration
-        alpha = score - 50;
-        beta = score + 50;
+        if (move)
+            sprintf(move_string, "%s%s", square_to_coordinates[get_move_source(move)],
+                                         square_to_coordinates[get_move_target(move)]);
         
-        // if PV is available
-        if (pv_length[0])
+        if (get_move_promoted(move))
+            move_string[4] = promoted_pieces[get_move_promoted(move)];
+        
+        printf("%s,%s,%s,%s,%d,%d,", position->id, position->best_san, position->avoid_san,
+               move_string, position->solved, position->result.completed_depth);
+        
+        // time & nodes to solution
+        if (position->solved)
         {
-            // print search info
-            if (score > -mate_value && score < -mate_score)
-                printf("info score mate %d depth %d nodes %lld time %d pv ", -(score + mate_value) / 2 - 1, current_depth, nodes, get_time_ms() - start);
-            
-            else if (score > mate_score && score < mate_value)
-                printf("info score mate %d depth %d nodes %lld time %d pv ", (mate_value - score) / 2 + 1, current_depth, nodes, get_time_ms() - start);   
-            
-            else
-                printf("info score cp %d depth %d nodes %lld time %d pv ", score, current_depth, nodes, get_time_ms() - start);
-            
-            // loop over the moves within a PV line
-            for (int count = 0; count < pv_length[0]; count++)
-            {
-                // print PV move
-                print_move(pv_table[0][count]);
-                printf(" ");
-            }
+            printf("%d,%llu\n", position->result.best_move_time, position->result.best_move_nodes);
             
-            // print new line
-            printf("\n");
+            solved++;
+            solution_time += position->result.best_move_time;
+            solution_nodes += position->result.best_move_nodes;
         }
+        
+        else
+            printf(",\n");
     }
-
-    // print best move
-    printf("bestmove ");
-    print_move(pv_table[0][0]);
-    printf("\n");
+    
+    printf("info string solved %d of %d, time to solutions %ld ms, nodes to solutions %llu, total time %ld ms\n",
+           solved, epd_position_count, solution_time, solution_nodes, time);
+    
+    // restore UCI position
+    parse_fen(start_position);
 }
 
+
 /**********************************\
  ==================================
  
@@ -4515,12 +7135,16 @@ void reset_time_control()
     quit = 0;
     movestogo = 30;
     movetime = -1;
-    time = -1;
+    uci_time = -1;
     inc = 0;
     starttime = 0;
     stoptime = 0;
     timeset = 0;
     stopped = 0;
+    infinite = 0;
+    pondering = 0;
+    ponder_time = -1;
+    optimum_time = -1;
 }
 
 // parse UCI command "go"
@@ -4535,8 +7159,11 @@ void parse_go(char *command)
     // init argument
     char *argument = NULL;
 
-    // infinite search
-    if ((argument = strstr(command,"infinite"))) {}
+    // infinite search (until "stop")
+    int infinite_search = strstr(command, "infinite") != NULL;
+    
+    // pondering (until "ponderhit" or "stop")
+    pondering = strstr(command, "ponder") != NULL;
 
     // match UCI "binc" command
     if ((argument = strstr(command,"binc")) && side == black)
@@ -4551,12 +7178,12 @@ void parse_go(char *command)
     // match UCI "wtime" command
     if ((argument = strstr(command,"wtime")) && side == white)
         // parse white time limit
-        time = atoi(argument + 6);
+        uci_time = atoi(argument + 6);
 
     // match UCI "btime" command
     if ((argument = strstr(command,"btime")) && side == black)
         // parse black time limit
-        time = atoi(argument + 6);
+        uci_time = atoi(argument + 6);
 
     // match UCI "movestogo" command
     if ((argument = strstr(command,"movestogo")))
@@ -4577,7 +7204,7 @@ void parse_go(char *command)
     if(movetime != -1)
     {
         // set time equal to move time
-        time = movetime;
+        uci_time = movetime;
 
         // set moves to go to 1
         movestogo = 1;
@@ -4590,22 +7217,44 @@ void parse_go(char *command)
     depth = depth;
 
     // if time control is available
-    if(time != -1)
+    if(uci_time != -1)
     {
         // flag we're playing with time control
         timeset = 1;
+        
+        // time left on the clock
+        int time_left = uci_time;
 
         // set up timing
-        time /= movestogo;
+        uci_time /= movestogo;
         
         // disable time buffer when time is almost up
-        if (time > 1500) time -= 50;
+        if (uci_time > 1500) uci_time -= 50;
         
         // init stoptime
-        stoptime = starttime + time + inc;
+        stoptime = starttime + uci_time + inc;
+        
+        // manage time unless it's fixed per move
+        if (movetime == -1)
+        {
+            // time to think for when the search goes as expected
+            optimum_time = uci_time + inc;
+            
+            // hard limit is a few times the optimum within a share of the time left
+            int maximum_time = optimum_time * 4;
+            if (maximum_time > time_left / 3 + inc) maximum_time = time_left / 3 + inc;
+            if (maximum_time < optimum_time) maximum_time = optimum_time;
+            
+            // never go beyond the time left keeping a margin for communication
+            if (maximum_time > time_left - 50) maximum_time = time_left > 100 ? time_left - 50 : time_left / 2;
+            if (optimum_time > maximum_time) optimum_time = maximum_time;
+            
+            // init stoptime
+            stoptime = starttime + maximum_time;
+        }
         
         // treat increment as seconds per move when time is almost up
-        if (time < 1500 && inc && depth == 64) stoptime = starttime + inc - 50;
+        if (uci_time < 1500 && inc && depth == 64) stoptime = starttime + inc - 50;
     }
 
     // if depth is not available
@@ -4613,9 +7262,22 @@ void parse_go(char *command)
         // set depth to 64 plies (takes ages to complete...)
         depth = 64;
 
+    // pondering & infinite search don't stop on their own
+    if (pondering || infinite_search)
+    {
+        // keep time to think for after "ponderhit"
+        ponder_time = timeset ? stoptime - starttime : -1;
+        timeset = 0;
+        infinite = 1;
+        
+        // "ponderhit" may have arrived already
+        if (pondering && ponderhit)
+            infinite = 0;
+    }
+    
     // print debug info
     printf("time: %d  start: %u  stop: %u  depth: %d  timeset:%d\n",
-            time, starttime, stoptime, depth, timeset);
+            uci_time, starttime, stoptime, depth, timeset);
 
     // search position
     search_position(depth);
@@ -4630,17 +7292,23 @@ void uci_loop()
     // default MB value
     int mb = 64;
 
-    // reset STDIN & STDOUT buffers
-    setbuf(stdin, NULL);
+    // reset STDOUT buffer
     setbuf(stdout, NULL);
     
     // define user / GUI input buffer
-    char input[2000];
+    char input[max_input_length];
+    
+    // start reading GUI input in a separate thread
+    init_input_thread();
     
     // print engine info
     printf("id name BBC %s\n", version);
     printf("id author Code Monkey King\n");
     printf("option name Hash type spin default 64 min 4 max %d\n", max_hash);
+    printf("option name Threads type spin default 1 min 1 max %d\n", max_threads);
+    printf("option name Ponder type check default false\n");
+    printf("option name SyzygyPath type string default <empty>\n");
+    printf("option name SyzygyProbeLimit type spin default 6 min 0 max 6\n");
     printf("uciok\n");
     
     // main loop
@@ -4653,9 +7321,7 @@ void uci_loop()
         fflush(stdout);
         
         // get user / GUI input
-        if (!fgets(input, 2000, stdin))
-            // continue the loop
-            continue;
+        pop_input(input);
         
         // make sure input is available
         if (input[0] == '\n')
@@ -4672,11 +7338,8 @@ void uci_loop()
         // parse UCI "position" command
         else if (strncmp(input, "position", 8) == 0)
         {
-            // call parse position function
+            // call parse position function (hash table is kept, older entries get aged out)
             parse_position(input);
-        
-            // clear hash table
-            clear_hash_table();
         }
         // parse UCI "ucinewgame" command
         else if (strncmp(input, "ucinewgame", 10) == 0)
@@ -4692,6 +7355,105 @@ void uci_loop()
             // call parse go function
             parse_go(input);
         
+        // parse "perft <depth> [threads <n>] [hash <mb>] [split <plies>]" command
+        else if (strncmp(input, "perft", 5) == 0)
+        {
+            int depth = atoi(input + 6);
+            int perft_threads = 1, perft_hash = 0;
+            char *argument = NULL;
+            
+            // parse number of threads
+            if ((argument = strstr(input, "threads")))
+                perft_threads = atoi(argument + 8);
+            
+            // parse perft hash table size in MB
+            if ((argument = strstr(input, "hash")))
+                perft_hash = atoi(argument + 5);
+            
+            // split at root moves, at the second ply if there are few of them per thread
+            int split_depth = perft_threads > 1 ? 2 : 1;
+            
+            // parse split depth
+            if ((argument = strstr(input, "split")))
+                split_depth = atoi(argument + 6);
+            
+            // clamp number of threads
+            if (perft_threads < 1) perft_threads = 1;
+            if (perft_threads > max_threads) perft_threads = max_threads;
+            
+            if (depth > 0)
+                perft_test(depth, perft_threads, perft_hash, split_depth);
+        }
+        
+        // parse "stats" command
+        else if (strncmp(input, "stats", 5) == 0)
+        {
+            // print last search statistics
+            #ifdef SEARCH_STATS
+            print_search_stats();
+            #else
+            printf("info string search statistics are not compiled in (make stats)\n");
+            #endif
+        }
+        
+        // parse "bench nnue" command
+        else if (strncmp(input, "bench nnue", 10) == 0)
+            // print evaluations per second of every NNUE SIMD backend
+            bench_nnue();
+        
+        // parse "bench pawns [depth]" command
+        else if (strncmp(input, "bench pawns", 11) == 0)
+        {
+            // tree depth to evaluate leaf positions at
+            int depth = atoi(input + 11);
+            
+            // print handcrafted evaluation time with and without pawn hash table
+            bench_pawn_table(depth > 0 ? depth : 5);
+        }
+        
+        // parse "epd <file> [movetime <ms>] [jobs <n>]" command
+        else if (strncmp(input, "epd ", 4) == 0)
+        {
+            int position_time = 1000, jobs = 1;
+            char *argument = NULL;
+            
+            // parse time per position
+            if ((argument = strstr(input, "movetime")))
+                position_time = atoi(argument + 9);
+            
+            // parse number of positions searched at once
+            if ((argument = strstr(input, "jobs")))
+                jobs = atoi(argument + 5);
+            
+            // file name is the first argument
+            char file_name[max_input_length];
+            sscanf(input + 4, "%s", file_name);
+            
+            run_epd(file_name, position_time, jobs);
+        }
+        
+        // parse "bench [depth] [hash] [threads]" command
+        else if (strncmp(input, "bench", 5) == 0)
+        {
+            // defaults: depth 6, current hash size, single thread
+            int depth = 6, bench_mb = mb, bench_threads = 1;
+            sscanf(input + 5, "%d %d %d", &depth, &bench_mb, &bench_threads);
+            
+            // adjust hash size if going beyond the allowed bounds
+            if (bench_mb > max_hash) bench_mb = max_hash;
+            
+            // keep number of threads set via UCI
+            int uci_threads = threads;
+            
+            // search bench positions
+            bench(depth, bench_mb, bench_threads);
+            
+            // restore UCI settings & position
+            threads = uci_threads;
+            init_hash_table(mb);
+            parse_position("position startpos");
+        }
+        
         // parse UCI "quit" command
         else if (strncmp(input, "quit", 4) == 0)
             // quit from the UCI loop (terminate program)
@@ -4718,6 +7480,38 @@ void uci_loop()
             printf("    Set hash table size to %dMB\n", mb);
             init_hash_table(mb);
         }
+        
+        else if (!strncmp(input, "setoption name Threads value ", 29)) {
+            // init number of search threads
+            sscanf(input,"%*s %*s %*s %*s %d", &threads);
+            
+            // adjust number of threads if going beyond the allowed bounds
+            if(threads < 1) threads = 1;
+            if(threads > max_threads) threads = max_threads;
+            
+            // set number of search threads
+            printf("    Set number of search threads to %d\n", threads);
+        }
+        
+        else if (!strncmp(input, "setoption name SyzygyPath value ", 32)) {
+            // strip line break
+            input[strcspn(input, "\r\n")] = '\0';
+            
+            // load tablebases (empty path unloads them)
+            init_syzygy(strcmp(input + 32, "<empty>") ? input + 32 : "");
+        }
+        
+        else if (!strncmp(input, "setoption name SyzygyProbeLimit value ", 38)) {
+            // init max number of pieces to probe tablebases for
+            syzygy_probe_limit = atoi(input + 38);
+            
+            // adjust probe limit if going beyond the allowed bounds
+            if (syzygy_probe_limit < 0) syzygy_probe_limit = 0;
+            if (syzygy_probe_limit > 6) syzygy_probe_limit = 6;
+            
+            // probe up to the largest tables available
+            tb_pieces = (int)TB_LARGEST < syzygy_probe_limit ? (int)TB_LARGEST : syzygy_probe_limit;
+        }
     }
 }
 
@@ -4740,6 +7534,9 @@ void init_all()
     init_sliders_attacks(bishop);
     init_sliders_attacks(rook);
     
+    // init masks of squares in between & on the same line
+    init_line_masks();
+    
     // init random keys for hashing purposes
     init_random_keys();
     
@@ -4832,11 +7629,137 @@ static inline void nnue_input(int *pieces, int *squares)
     squares[index] = 0;
 }
 
-int main()
+// number of positions evaluated per NNUE batch
+#define label_batch_size 16384
+
+// evaluate every FEN/EPD line of input file, write "fen | score" lines to output file
+void label_positions(char *input_file, char *output_file, int thread_count)
+{
+    // open files
+    FILE *input = fopen(input_file, "r");
+    FILE *output = fopen(output_file, "w");
+    
+    // unable to open files
+    if (input == NULL || output == NULL)
+    {
+        printf("Unable to open %s\n", input == NULL ? input_file : output_file);
+        if (input) fclose(input);
+        if (output) fclose(output);
+        return;
+    }
+    
+    // allocate batch buffers
+    char (*fens)[256] = malloc(label_batch_size * sizeof(*fens));
+    int *players = malloc(label_batch_size * sizeof(int));
+    int (*pieces)[33] = malloc(label_batch_size * sizeof(*pieces));
+    int (*squares)[33] = malloc(label_batch_size * sizeof(*squares));
+    int *scores = malloc(label_batch_size * sizeof(int));
+    
+    // total positions & time spent evaluating
+    long long total = 0;
+    int eval_time = 0;
+    int start = get_time_ms();
+    
+    // positions in current batch
+    int count = 0;
+    
+    // read input lines
+    char line[256];
+    int end_of_file = 0;
+    
+    while (!end_of_file)
+    {
+        // fill batch
+        if (fgets(line, sizeof(line), input) == NULL)
+            end_of_file = 1;
+        
+        else
+        {
+            // cut EPD operations & line break
+            line[strcspn(line, ";\r\n")] = '\0';
+            
+            // skip empty lines
+            if (line[0] == '\0')
+                continue;
+            
+            // parse position and convert it to NNUE input
+            strcpy(fens[count], line);
+            parse_fen(line);
+            players[count] = side;
+            nnue_input(pieces[count], squares[count]);
+            count++;
+        }
+        
+        // evaluate full or last batch
+        if (count == label_batch_size || (end_of_file && count))
+        {
+            int batch_start = get_time_ms();
+            evaluate_batch_nnue(count, players, pieces, squares, scores, thread_count);
+            eval_time += get_time_ms() - batch_start;
+            
+            // write labels
+            for (int index = 0; index < count; index++)
+                fprintf(output, "%s | %d\n", fens[index], scores[index]);
+            
+            total += count;
+            count = 0;
+        }
+    }
+    
+    // print stats
+    printf("positions: %lld\n", total);
+    printf("time: %d ms (%d ms evaluating)\n", get_time_ms() - start, eval_time);
+    printf("positions/sec: %lld\n", total * 1000 / (eval_time ? eval_time : 1));
+    
+    // free batch buffers
+    free(fens);
+    free(players);
+    free(pieces);
+    free(squares);
+    free(scores);
+    
+    fclose(input);
+    fclose(output);
+}
+
+int main(int argc, char *argv[])
 {
     // init all
     init_all();
     
+    // label positions via NNUE: ./bbc label <input file> <output file> [threads]
+    if (argc >= 4 && strcmp(argv[1], "label") == 0)
+    {
+        label_positions(argv[2], argv[3], argc >= 5 ? atoi(argv[4]) : threads);
+        
+        // free hash table memory on exit
+        free(hash_memory);
+        
+        return 0;
+    }
+    
+    // search bench positions: ./bbc bench [depth] [hash] [threads]
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0)
+    {
+        bench(argc >= 3 ? atoi(argv[2]) : 6, argc >= 4 ? atoi(argv[3]) : 64, argc >= 5 ? atoi(argv[4]) : 1);
+        
+        // free hash table memory on exit
+        free(hash_memory);
+        
+        return 0;
+    }
+    
+    // write NNUE weight cache mapped on later starts: ./bbc cache
+    if (argc >= 2 && strcmp(argv[1], "cache") == 0)
+    {
+        int success = write_cache_nnue();
+        
+        // free hash table memory on exit
+        free(hash_memory);
+        
+        return success ? 0 : 1;
+    }
+    
     // connect to GUI
     uci_loop();
     
@@ -4861,7 +7784,7 @@ int main()
     printf("eval score: %d\n", eval_score);
     
     // free hash table memory on exit
-    free(hash_table);
+    free(hash_memory);
 
 
     // 0 op 1 end 2 mid
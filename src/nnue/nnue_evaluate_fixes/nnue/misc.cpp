@@ -39,6 +39,19 @@ size_t file_size(FD fd)
 #endif
 }
 
+uint64_t file_time(FD fd)
+{
+#ifndef _WIN32
+  struct stat statbuf;
+  fstat(fd, &statbuf);
+  return statbuf.st_mtime;
+#else
+  FILETIME writeTime;
+  GetFileTime(fd, NULL, NULL, &writeTime);
+  return ((uint64_t)writeTime.dwHighDateTime << 32) | writeTime.dwLowDateTime;
+#endif
+}
+
 const void *map_file(FD fd, map_t *map)
 {
 #ifndef _WIN32
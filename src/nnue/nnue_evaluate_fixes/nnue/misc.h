@@ -34,6 +34,7 @@ typedef size_t map_t;
 FD open_file(const char *name);
 void close_file(FD fd);
 size_t file_size(FD fd);
+uint64_t file_time(FD fd);
 const void *map_file(FD fd, map_t *map);
 void unmap_file(const void *data, map_t map);
 
@@ -64,7 +64,7 @@ enum {
   PS_END      = 10 * 64 + 1
 };
 
-uint32_t PieceToIndex[2][14] = {
+static uint32_t PieceToIndex[2][14] = {
   { 0, 0, PS_W_QUEEN, PS_W_ROOK, PS_W_BISHOP, PS_W_KNIGHT, PS_W_PAWN,
        0, PS_B_QUEEN, PS_B_ROOK, PS_B_BISHOP, PS_B_KNIGHT, PS_B_PAWN, 0},
   { 0, 0, PS_B_QUEEN, PS_B_ROOK, PS_B_BISHOP, PS_B_KNIGHT, PS_B_PAWN,
@@ -171,8 +171,16 @@ typedef uint64_t mask2_t;
 typedef uint32_t mask2_t;
 #endif
 
+// VNNI dot product of unsigned 8-bit inputs and signed 8-bit weights
+#if defined(USE_VNNI) && defined(USE_AVX512)
+#define vec512_dpbusd(acc,a,b) _mm512_dpbusd_epi32(acc,a,b)
+#define vec256_dpbusd(acc,a,b) _mm256_dpbusd_epi32(acc,a,b)
+#elif defined(USE_VNNI)
+#define vec256_dpbusd(acc,a,b) _mm256_dpbusd_avx_epi32(acc,a,b)
+#endif
+
 typedef int8_t clipped_t;
-#if defined(USE_MMX) || (defined(USE_SSE2) && !defined(USE_AVX2))
+#if defined(USE_MMX) || (defined(USE_SSE2) && !defined(USE_SSSE3))
 typedef int16_t weight_t;
 #else
 typedef int8_t weight_t;
@@ -205,7 +213,6 @@ static void half_kp_append_active_indices(const Position *pos, const int c,
   }
 }
 
-#if 0
 static void half_kp_append_changed_indices(const Position *pos, const int c,
     const DirtyPiece *dp, IndexList *removed, IndexList *added)
 {
@@ -220,7 +227,6 @@ static void half_kp_append_changed_indices(const Position *pos, const int c,
       added->values[added->size++] = make_index(c, dp->to[i], pc, ksq);
   }
 }
-#endif
 
 static void append_active_indices(const Position *pos, IndexList active[2])
 {
@@ -228,36 +234,11 @@ static void append_active_indices(const Position *pos, IndexList active[2])
     half_kp_append_active_indices(pos, c, &active[c]);
 }
 
-#if 0
-static void append_changed_indices(const Position *pos, IndexList removed[2],
-    IndexList added[2], bool reset[2])
+// Has the king of the given perspective moved (null moves have no dirty pieces)
+INLINE bool king_moved(const DirtyPiece *dp, const int c)
 {
-  const DirtyPiece *dp = &(pos->hstack[pos->hply].dirtyPiece);
-  assert(dp->dirtyNum != 0);
-
-  if (pos->hstack[pos->hply-1].accumulator.computedAccumulation) {
-    for (unsigned c = 0; c < 2; c++) {
-      reset[c] = dp->pc[0] == (int)COMBINE(c, king);
-      if (reset[c])
-        half_kp_append_active_indices(pos, c, &added[c]);
-      else
-        half_kp_append_changed_indices(pos, c, dp, &removed[c], &added[c]);
-    }
-  } else {
-    const DirtyPiece *dp2 = &(pos->hstack[pos->hply-1].dirtyPiece);
-    for (unsigned c = 0; c < 2; c++) {
-      reset[c] =   dp->pc[0] == (int)COMBINE(c, king)
-                || dp2->pc[0] == (int)COMBINE(c, king);
-      if (reset[c])
-        half_kp_append_active_indices(pos, c, &added[c]);
-      else {
-        half_kp_append_changed_indices(pos, c, dp, &removed[c], &added[c]);
-        half_kp_append_changed_indices(pos, c, dp2, &removed[c], &added[c]);
-      }
-    }
-  }
+  return dp->dirtyNum != 0 && dp->pc[0] == (int)COMBINE(c, king);
 }
-#endif
 
 // InputLayer = InputSlice<256 * 2>
 // out: 512 x clipped_t
@@ -271,18 +252,27 @@ static void append_changed_indices(const Position *pos, IndexList removed[2],
 // OutputLayer = AffineTransform<HiddenLayer2, 1>
 // 32 x clipped_t -> 1 x int32_t
 
+// Parameters are read into the *_buf arrays or mapped from a weight cache
 #if !defined(USE_AVX512)
-static weight_t hidden1_weights alignas(64) [32 * 512];
-static weight_t hidden2_weights alignas(64) [32 * 32];
+static weight_t hidden1_weights_buf alignas(64) [32 * 512];
+static weight_t hidden2_weights_buf alignas(64) [32 * 32];
 #else
-static weight_t hidden1_weights alignas(64) [64 * 512];
-static weight_t hidden2_weights alignas(64) [64 * 32];
+static weight_t hidden1_weights_buf alignas(64) [64 * 512];
+static weight_t hidden2_weights_buf alignas(64) [64 * 32];
 #endif
-static weight_t output_weights alignas(64) [1 * 32];
+static weight_t output_weights_buf alignas(64) [1 * 32];
 
-static int32_t hidden1_biases alignas(64) [32];
-static int32_t hidden2_biases alignas(64) [32];
-static int32_t output_biases[1];
+static int32_t hidden1_biases_buf alignas(64) [32];
+static int32_t hidden2_biases_buf alignas(64) [32];
+static int32_t output_biases_buf[1];
+
+static weight_t *hidden1_weights = hidden1_weights_buf;
+static weight_t *hidden2_weights = hidden2_weights_buf;
+static weight_t *output_weights = output_weights_buf;
+
+static int32_t *hidden1_biases = hidden1_biases_buf;
+static int32_t *hidden2_biases = hidden2_biases_buf;
+static int32_t *output_biases = output_biases_buf;
 
 INLINE int32_t affine_propagate(clipped_t *input, int32_t *biases,
     weight_t *weights)
@@ -291,7 +281,7 @@ INLINE int32_t affine_propagate(clipped_t *input, int32_t *biases,
   __m256i *iv = (__m256i *)input;
   __m256i *row = (__m256i *)weights;
 #if defined(USE_VNNI)
-  __m256i prod = _mm256_dpbusd_epi32(_mm256_setzero_si256(), iv[0], row[0]);
+  __m256i prod = vec256_dpbusd(_mm256_setzero_si256(), iv[0], row[0]);
 #else
   __m256i prod = _mm256_maddubs_epi16(iv[0], row[0]);
   prod = _mm256_madd_epi16(prod, _mm256_set1_epi16(1));
@@ -304,7 +294,7 @@ INLINE int32_t affine_propagate(clipped_t *input, int32_t *biases,
 #elif defined(USE_SSE2)
   __m128i *iv = (__m128i *)input;
   __m128i *row = (__m128i *)weights;
-#if defined(AVOID_USE_SSSE3)
+#if defined(USE_SSSE3)
   const __m128i kOnes = _mm_set1_epi16(1);
   __m128i p0 = _mm_madd_epi16(_mm_maddubs_epi16(iv[0], row[0]), kOnes);
   __m128i p1 = _mm_madd_epi16(_mm_maddubs_epi16(iv[1], row[1]), kOnes);
@@ -417,6 +407,34 @@ INLINE void affine_txfm(int8_t *input, void *output, unsigned inDims,
   unsigned idx;
 
   memcpy(&v, inMask, sizeof(mask2_t));
+#if defined(USE_VNNI)
+  // VNNI sums up four inputs per 32-bit lane, so take the rows by four
+  __m512i third, fourth;
+  for (unsigned offset = 0; offset < inDims;) {
+    if (!next_idx(&idx, &offset, &v, inMask, inDims))
+      break;
+    first = ((__m512i *)weights)[idx];
+    uint32_t factor = input[idx];
+    second = third = fourth = kZero;
+    if (next_idx(&idx, &offset, &v, inMask, inDims)) {
+      second = ((__m512i *)weights)[idx];
+      factor |= input[idx] << 8;
+      if (next_idx(&idx, &offset, &v, inMask, inDims)) {
+        third = ((__m512i *)weights)[idx];
+        factor |= input[idx] << 16;
+        if (next_idx(&idx, &offset, &v, inMask, inDims)) {
+          fourth = ((__m512i *)weights)[idx];
+          factor |= (uint32_t)input[idx] << 24;
+        }
+      }
+    }
+    __m512i mul = _mm512_set1_epi32(factor);
+    __m512i lo_0 = _mm512_unpacklo_epi8(first, second);
+    __m512i lo_1 = _mm512_unpacklo_epi8(third, fourth);
+    out_0 = vec512_dpbusd(out_0, mul, _mm512_unpacklo_epi16(lo_0, lo_1));
+    out_1 = vec512_dpbusd(out_1, mul, _mm512_unpackhi_epi16(lo_0, lo_1));
+  }
+#else
   for (unsigned offset = 0; offset < inDims;) {
     if (!next_idx(&idx, &offset, &v, inMask, inDims))
       break;
@@ -434,6 +452,7 @@ INLINE void affine_txfm(int8_t *input, void *output, unsigned inDims,
     out_0 = _mm512_add_epi32(out_0, _mm512_unpacklo_epi16(prod, signs));
     out_1 = _mm512_add_epi32(out_1, _mm512_unpackhi_epi16(prod, signs));
   }
+#endif
 
   __m512i out16 = _mm512_srai_epi16(_mm512_packs_epi32(out_0, out_1), SHIFT);
 
@@ -464,6 +483,38 @@ INLINE void affine_txfm(int8_t *input, void *output, unsigned inDims,
   unsigned idx;
 
   memcpy(&v, inMask, sizeof(mask2_t));
+#if defined(USE_VNNI)
+  // VNNI sums up four inputs per 32-bit lane, so take the rows by four
+  __m256i third, fourth;
+  for (unsigned offset = 0; offset < inDims;) {
+    if (!next_idx(&idx, &offset, &v, inMask, inDims))
+      break;
+    first = ((__m256i *)weights)[idx];
+    uint32_t factor = input[idx];
+    second = third = fourth = kZero;
+    if (next_idx(&idx, &offset, &v, inMask, inDims)) {
+      second = ((__m256i *)weights)[idx];
+      factor |= input[idx] << 8;
+      if (next_idx(&idx, &offset, &v, inMask, inDims)) {
+        third = ((__m256i *)weights)[idx];
+        factor |= input[idx] << 16;
+        if (next_idx(&idx, &offset, &v, inMask, inDims)) {
+          fourth = ((__m256i *)weights)[idx];
+          factor |= (uint32_t)input[idx] << 24;
+        }
+      }
+    }
+    __m256i mul = _mm256_set1_epi32(factor);
+    __m256i lo_0 = _mm256_unpacklo_epi8(first, second);
+    __m256i lo_1 = _mm256_unpacklo_epi8(third, fourth);
+    __m256i hi_0 = _mm256_unpackhi_epi8(first, second);
+    __m256i hi_1 = _mm256_unpackhi_epi8(third, fourth);
+    out_0 = vec256_dpbusd(out_0, mul, _mm256_unpacklo_epi16(lo_0, lo_1));
+    out_1 = vec256_dpbusd(out_1, mul, _mm256_unpackhi_epi16(lo_0, lo_1));
+    out_2 = vec256_dpbusd(out_2, mul, _mm256_unpacklo_epi16(hi_0, hi_1));
+    out_3 = vec256_dpbusd(out_3, mul, _mm256_unpackhi_epi16(hi_0, hi_1));
+  }
+#else
   for (unsigned offset = 0; offset < inDims;) {
     if (!next_idx(&idx, &offset, &v, inMask, inDims))
       break;
@@ -485,6 +536,7 @@ INLINE void affine_txfm(int8_t *input, void *output, unsigned inDims,
     out_2 = _mm256_add_epi32(out_2, _mm256_unpacklo_epi16(prod, signs));
     out_3 = _mm256_add_epi32(out_3, _mm256_unpackhi_epi16(prod, signs));
   }
+#endif
 
   __m256i out16_0 = _mm256_srai_epi16(_mm256_packs_epi32(out_0, out_1), SHIFT);
   __m256i out16_1 = _mm256_srai_epi16(_mm256_packs_epi32(out_2, out_3), SHIFT);
@@ -496,7 +548,7 @@ INLINE void affine_txfm(int8_t *input, void *output, unsigned inDims,
   else
     outVec[0] = _mm256_max_epi8(outVec[0], kZero);
 }
-#elif AVOID_USE_SSSE3
+#elif defined(USE_SSSE3)
 INLINE void affine_txfm(int8_t *input, void *output, unsigned inDims,
     unsigned outDims, const int32_t *biases, const weight_t *weights,
     mask_t *inMask, mask_t *outMask, const bool pack8_and_calc_mask)
@@ -876,163 +928,192 @@ INLINE void affine_txfm(clipped_t *input, void *output, unsigned inDims,
 #endif
 
 // Input feature converter
-static int16_t ft_biases alignas(64) [kHalfDimensions];
-static int16_t ft_weights alignas(64) [kHalfDimensions * FtInDims];
+static int16_t ft_biases_buf alignas(64) [kHalfDimensions];
+static int16_t ft_weights_buf alignas(64) [kHalfDimensions * FtInDims];
+
+static int16_t *ft_biases = ft_biases_buf;
+static int16_t *ft_weights = ft_weights_buf;
 
 #ifdef VECTOR
 #define TILE_HEIGHT (NUM_REGS * SIMD_WIDTH / 16)
 #endif
 
+// Calculate cumulative value of one perspective without using difference calculation
+INLINE void refresh_half(const Position *pos, Accumulator *accumulator,
+    const unsigned c)
+{
+  IndexList activeIndices;
+  activeIndices.size = 0;
+  half_kp_append_active_indices(pos, c, &activeIndices);
+
+#ifdef VECTOR
+  for (unsigned i = 0; i < kHalfDimensions / TILE_HEIGHT; i++) {
+    vec16_t *ft_biases_tile = (vec16_t *)&ft_biases[i * TILE_HEIGHT];
+    vec16_t *accTile = (vec16_t *)&accumulator->accumulation[c][i * TILE_HEIGHT];
+    vec16_t acc[NUM_REGS];
+
+    for (unsigned j = 0; j < NUM_REGS; j++)
+      acc[j] = ft_biases_tile[j];
+
+    for (size_t k = 0; k < activeIndices.size; k++) {
+      unsigned index = activeIndices.values[k];
+      unsigned offset = kHalfDimensions * index + i * TILE_HEIGHT;
+      vec16_t *column = (vec16_t *)&ft_weights[offset];
+
+      for (unsigned j = 0; j < NUM_REGS; j++)
+        acc[j] = vec_add_16(acc[j], column[j]);
+    }
+
+    for (unsigned j = 0; j < NUM_REGS; j++)
+      accTile[j] = acc[j];
+  }
+#else
+  memcpy(accumulator->accumulation[c], ft_biases,
+      kHalfDimensions * sizeof(int16_t));
+
+  for (size_t k = 0; k < activeIndices.size; k++) {
+    unsigned index = activeIndices.values[k];
+    unsigned offset = kHalfDimensions * index;
+
+    for (unsigned j = 0; j < kHalfDimensions; j++)
+      accumulator->accumulation[c][j] += ft_weights[offset + j];
+  }
+#endif
+}
+
 // Calculate cumulative value without using difference calculation
-INLINE void refresh_accumulator(Position *pos)
+INLINE void refresh_accumulator(Position *pos, Accumulator *accumulator)
 {
-  Accumulator *accumulator = &(pos->accumulator);
+  for (unsigned c = 0; c < 2; c++)
+    refresh_half(pos, accumulator, c);
+
+  accumulator->computedAccumulation = true;
+}
 
-  IndexList activeIndices[2];
-  activeIndices[0].size = activeIndices[1].size = 0;
-  append_active_indices(pos, activeIndices);
+// Apply the features changed by one move to one perspective of prevAcc
+INLINE void update_half(const Position *pos, const Accumulator *prevAcc,
+    Accumulator *accumulator, const unsigned c, const DirtyPiece *dp)
+{
+  IndexList removed_indices, added_indices;
+  removed_indices.size = added_indices.size = 0;
+  half_kp_append_changed_indices(pos, c, dp, &removed_indices, &added_indices);
 
-  for (unsigned c = 0; c < 2; c++) {
 #ifdef VECTOR
-    for (unsigned i = 0; i < kHalfDimensions / TILE_HEIGHT; i++) {
-      vec16_t *ft_biases_tile = (vec16_t *)&ft_biases[i * TILE_HEIGHT];
-      vec16_t *accTile = (vec16_t *)&accumulator->accumulation[c][i * TILE_HEIGHT];
-      vec16_t acc[NUM_REGS];
+  for (unsigned i = 0; i < kHalfDimensions / TILE_HEIGHT; i++) {
+    vec16_t *accTile = (vec16_t *)&accumulator->accumulation[c][i * TILE_HEIGHT];
+    vec16_t *prevAccTile = (vec16_t *)&prevAcc->accumulation[c][i * TILE_HEIGHT];
+    vec16_t acc[NUM_REGS];
 
-      for (unsigned j = 0; j < NUM_REGS; j++)
-        acc[j] = ft_biases_tile[j];
+    for (unsigned j = 0; j < NUM_REGS; j++)
+      acc[j] = prevAccTile[j];
 
-      for (size_t k = 0; k < activeIndices[c].size; k++) {
-        unsigned index = activeIndices[c].values[k];
-        unsigned offset = kHalfDimensions * index + i * TILE_HEIGHT;
-        vec16_t *column = (vec16_t *)&ft_weights[offset];
+    // Difference calculation for the deactivated features
+    for (unsigned k = 0; k < removed_indices.size; k++) {
+      unsigned index = removed_indices.values[k];
+      const unsigned offset = kHalfDimensions * index + i * TILE_HEIGHT;
 
-        for (unsigned j = 0; j < NUM_REGS; j++)
-          acc[j] = vec_add_16(acc[j], column[j]);
-      }
+      vec16_t *column = (vec16_t *)&ft_weights[offset];
+      for (unsigned j = 0; j < NUM_REGS; j++)
+        acc[j] = vec_sub_16(acc[j], column[j]);
+    }
+
+    // Difference calculation for the activated features
+    for (unsigned k = 0; k < added_indices.size; k++) {
+      unsigned index = added_indices.values[k];
+      const unsigned offset = kHalfDimensions * index + i * TILE_HEIGHT;
 
+      vec16_t *column = (vec16_t *)&ft_weights[offset];
       for (unsigned j = 0; j < NUM_REGS; j++)
-        accTile[j] = acc[j];
+        acc[j] = vec_add_16(acc[j], column[j]);
     }
+
+    for (unsigned j = 0; j < NUM_REGS; j++)
+      accTile[j] = acc[j];
+  }
 #else
-    memcpy(accumulator->accumulation[c], ft_biases,
+  if (accumulator != prevAcc)
+    memcpy(accumulator->accumulation[c], prevAcc->accumulation[c],
         kHalfDimensions * sizeof(int16_t));
 
-    for (size_t k = 0; k < activeIndices[c].size; k++) {
-      unsigned index = activeIndices[c].values[k];
-      unsigned offset = kHalfDimensions * index;
+  // Difference calculation for the deactivated features
+  for (unsigned k = 0; k < removed_indices.size; k++) {
+    unsigned index = removed_indices.values[k];
+    const unsigned offset = kHalfDimensions * index;
 
-      for (unsigned j = 0; j < kHalfDimensions; j++)
-        accumulator->accumulation[c][j] += ft_weights[offset + j];
-    }
-#endif
+    for (unsigned j = 0; j < kHalfDimensions; j++)
+      accumulator->accumulation[c][j] -= ft_weights[offset + j];
   }
 
-  accumulator->computedAccumulation = true;
+  // Difference calculation for the activated features
+  for (unsigned k = 0; k < added_indices.size; k++) {
+    unsigned index = added_indices.values[k];
+    const unsigned offset = kHalfDimensions * index;
+
+    for (unsigned j = 0; j < kHalfDimensions; j++)
+      accumulator->accumulation[c][j] += ft_weights[offset + j];
+  }
+#endif
 }
 
-#if 0
 // Calculate cumulative value using difference calculation if possible
 INLINE bool update_accumulator(Position *pos)
 {
-  Accumulator *accumulator = &(pos->hstack[pos->hply].accumulator);
+  NNUEdata **nnue = pos->nnue;
+  Accumulator *accumulator = &nnue[0]->accumulator;
   if (accumulator->computedAccumulation)
     return true;
 
-  Accumulator *prevAcc;
-  if (   (pos->hply < 1 || !(prevAcc = &pos->hstack[pos->hply-1].accumulator)->computedAccumulation)
-      && (pos->hply < 2 || !(prevAcc = &pos->hstack[pos->hply-2].accumulator)->computedAccumulation) )
+  // Find the nearest ancestor with a computed accumulator
+  unsigned base = 1;
+  while (nnue[base] && !nnue[base]->accumulator.computedAccumulation)
+    base++;
+  if (!nnue[base])
     return false;
 
-  IndexList removed_indices[2], added_indices[2];
-  removed_indices[0].size = removed_indices[1].size = 0;
-  added_indices[0].size = added_indices[1].size = 0;
-  bool reset[2];
-  append_changed_indices(pos, removed_indices, added_indices, reset);
-
-#ifdef VECTOR
-  for (unsigned i = 0; i< kHalfDimensions / TILE_HEIGHT; i++) {
-    for (unsigned c = 0; c < 2; c++) {
-      vec16_t *accTile = (vec16_t *)&accumulator->accumulation[c][i * TILE_HEIGHT];
-      vec16_t acc[NUM_REGS];
-
-      if (reset[c]) {
-        vec16_t *ft_b_tile = (vec16_t *)&ft_biases[i * TILE_HEIGHT];
-        for (unsigned j = 0; j < NUM_REGS; j++)
-          acc[j] = ft_b_tile[j];
-      } else {
-        vec16_t *prevAccTile = (vec16_t *)&prevAcc->accumulation[c][i * TILE_HEIGHT];
-        for (unsigned j = 0; j < NUM_REGS; j++)
-          acc[j] = prevAccTile[j];
-
-        // Difference calculation for the deactivated features
-        for (unsigned k = 0; k < removed_indices[c].size; k++) {
-          unsigned index = removed_indices[c].values[k];
-          const unsigned offset = kHalfDimensions * index + i * TILE_HEIGHT;
-
-          vec16_t *column = (vec16_t *)&ft_weights[offset];
-          for (unsigned j = 0; j < NUM_REGS; j++)
-            acc[j] = vec_sub_16(acc[j], column[j]);
-        }
-      }
-
-      // Difference calculation for the activated features
-      for (unsigned k = 0; k < added_indices[c].size; k++) {
-        unsigned index = added_indices[c].values[k];
-        const unsigned offset = kHalfDimensions * index + i * TILE_HEIGHT;
-
-        vec16_t *column = (vec16_t *)&ft_weights[offset];
-        for (unsigned j = 0; j < NUM_REGS; j++)
-          acc[j] = vec_add_16(acc[j], column[j]);
-      }
-
-      for (unsigned j = 0; j < NUM_REGS; j++)
-        accTile[j] = acc[j];
+  // Kings that moved on the way down invalidate their perspective
+  bool reset[2] = { false, false };
+  for (unsigned i = 0; i < base; i++)
+    for (unsigned c = 0; c < 2; c++)
+      reset[c] |= king_moved(&nnue[i]->dirtyPiece, c);
+
+  // Without king moves the king squares of all the intermediate
+  // positions are known, so bring their accumulators up to date
+  // to let the siblings of the current position reuse them
+  if (!reset[0] && !reset[1]) {
+    for (unsigned i = base - 1; i > 0; i--) {
+      for (unsigned c = 0; c < 2; c++)
+        update_half(pos, &nnue[i + 1]->accumulator, &nnue[i]->accumulator,
+            c, &nnue[i]->dirtyPiece);
+      nnue[i]->accumulator.computedAccumulation = true;
     }
+    base = 1;
   }
-#else
+
+  // Otherwise apply all the changes straight to the current accumulator
   for (unsigned c = 0; c < 2; c++) {
     if (reset[c]) {
-      memcpy(accumulator->accumulation[c], ft_biases,
-          kHalfDimensions * sizeof(int16_t));
-    } else {
-      memcpy(accumulator->accumulation[c], prevAcc->accumulation[c],
-          kHalfDimensions * sizeof(int16_t));
-      // Difference calculation for the deactivated features
-      for (unsigned k = 0; k < removed_indices[c].size; k++) {
-        unsigned index = removed_indices[c].values[k];
-        const unsigned offset = kHalfDimensions * index;
-
-        for (unsigned j = 0; j < kHalfDimensions; j++)
-          accumulator->accumulation[c][j] -= ft_weights[offset + j];
-      }
+      refresh_half(pos, accumulator, c);
+      continue;
     }
-
-    // Difference calculation for the activated features
-    for (unsigned k = 0; k < added_indices[c].size; k++) {
-      unsigned index = added_indices[c].values[k];
-      const unsigned offset = kHalfDimensions * index;
-
-      for (unsigned j = 0; j < kHalfDimensions; j++)
-        accumulator->accumulation[c][j] += ft_weights[offset + j];
+    const Accumulator *prevAcc = &nnue[base]->accumulator;
+    for (unsigned i = base; i-- > 0; ) {
+      update_half(pos, prevAcc, accumulator, c, &nnue[i]->dirtyPiece);
+      prevAcc = accumulator;
     }
   }
-#endif
 
   accumulator->computedAccumulation = true;
   return true;
 }
-#endif
 
 // Convert input features
 INLINE void transform(Position *pos, clipped_t *output, mask_t *outMask)
 {
-#if 0
+  Accumulator *accumulator = &pos->nnue[0]->accumulator;
   if (!update_accumulator(pos))
-#endif
-    refresh_accumulator(pos);
+    refresh_accumulator(pos, accumulator);
 
-  int16_t (*accumulation)[2][256] = &pos->accumulator.accumulation;
+  int16_t (*accumulation)[2][256] = &accumulator->accumulation;
   (void)outMask; // avoid compiler warning
 
   const int perspectives[2] = { pos->player, !pos->player };
@@ -1063,7 +1144,7 @@ INLINE void transform(Position *pos, clipped_t *output, mask_t *outMask)
 struct NetData {
   alignas(64) clipped_t input[FtOutDims];
   clipped_t hidden1_out[32];
-#if (defined(USE_SSE2) || defined(USE_MMX)) && !defined(USE_AVX2)
+#if (defined(USE_SSE2) || defined(USE_MMX)) && !defined(USE_SSSE3)
   int16_t hidden2_out[32];
 #else
   int8_t hidden2_out[32];
@@ -1237,12 +1318,165 @@ static void init_weights(const void *evalData)
 #endif
 }
 
+/*
+Weight cache: the parameters in the layout of this backend, mapped
+read-only so that engine processes share its pages
+*/
+#define NNUE_STR_(x) #x
+#define NNUE_STR(x) NNUE_STR_(x)
+#ifdef NNUE_BACKEND
+#define CacheBackend NNUE_STR(NNUE_BACKEND)
+#else
+#define CacheBackend "native"
+#endif
+
+#define CacheAlign(size) (((size) + 63) & ~(size_t)63)
+
+enum {
+  CacheMagic = 0x4e4e4243, // "CBNN"
+  CacheVersion = 1
+};
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t netSize;
+  uint64_t netTime;
+  char backend[16];
+  char padding[24];
+} CacheHeader;
+
+static const struct {
+  void **data;
+  void *buf;
+  size_t size;
+} cacheSections[] = {
+  { (void **)&ft_biases, ft_biases_buf, sizeof(ft_biases_buf) },
+  { (void **)&ft_weights, ft_weights_buf, sizeof(ft_weights_buf) },
+  { (void **)&hidden1_biases, hidden1_biases_buf, sizeof(hidden1_biases_buf) },
+  { (void **)&hidden1_weights, hidden1_weights_buf, sizeof(hidden1_weights_buf) },
+  { (void **)&hidden2_biases, hidden2_biases_buf, sizeof(hidden2_biases_buf) },
+  { (void **)&hidden2_weights, hidden2_weights_buf, sizeof(hidden2_weights_buf) },
+  { (void **)&output_biases, output_biases_buf, sizeof(output_biases_buf) },
+  { (void **)&output_weights, output_weights_buf, sizeof(output_weights_buf) }
+};
+
+#define CacheSections (sizeof(cacheSections) / sizeof(cacheSections[0]))
+
+static const void *cacheData = NULL;
+static map_t cacheMapping;
+static uint64_t netSize, netTime;
+
+static size_t cache_size(void)
+{
+  size_t size = sizeof(CacheHeader);
+  for (unsigned i = 0; i < CacheSections; i++)
+    size += CacheAlign(cacheSections[i].size);
+  return size;
+}
+
+// Cache file of a network for this backend, "<evalFile>.<backend>.cache"
+static char *cache_file_name(const char *evalFile)
+{
+  const char *suffix = "." CacheBackend ".cache";
+  char *name = (char *)malloc(strlen(evalFile) + strlen(suffix) + 1);
+  strcpy(name, evalFile);
+  strcat(name, suffix);
+  return name;
+}
+
+// Point the parameters back to the arrays
+static void release_cache(void)
+{
+  for (unsigned i = 0; i < CacheSections; i++)
+    *cacheSections[i].data = cacheSections[i].buf;
+
+  if (cacheData) unmap_file(cacheData, cacheMapping);
+  cacheData = NULL;
+}
+
+// Point the parameters into the cache if it matches the network file
+static bool map_cache(const char *cacheFile)
+{
+  map_t mapping;
+
+  FD fd = open_file(cacheFile);
+  if (fd == FD_ERR) return false;
+  const void *data = map_file(fd, &mapping);
+  size_t size = file_size(fd);
+  close_file(fd);
+  if (!data) return false;
+
+  const CacheHeader *header = (const CacheHeader *)data;
+  if (   size != cache_size()
+      || header->magic != CacheMagic
+      || header->version != CacheVersion
+      || header->netSize != netSize
+      || header->netTime != netTime
+      || strncmp(header->backend, CacheBackend, sizeof(header->backend)))
+  {
+    unmap_file(data, mapping);
+    return false;
+  }
+
+  const char *d = (const char *)data + sizeof(CacheHeader);
+  for (unsigned i = 0; i < CacheSections; i++) {
+    *cacheSections[i].data = (void *)d;
+    d += CacheAlign(cacheSections[i].size);
+  }
+
+  cacheData = data;
+  cacheMapping = mapping;
+  return true;
+}
+
+// Write the parameters to a temporary file and move it into place, so
+// processes mapping the old cache never see it truncated
+static bool write_cache(const char *cacheFile)
+{
+  static const char zeros[64] = { 0 };
+  CacheHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = CacheMagic;
+  header.version = CacheVersion;
+  header.netSize = netSize;
+  header.netTime = netTime;
+  strncpy(header.backend, CacheBackend, sizeof(header.backend) - 1);
+
+  char *tmpFile = (char *)malloc(strlen(cacheFile) + 5);
+  strcpy(tmpFile, cacheFile);
+  strcat(tmpFile, ".tmp");
+
+  FILE *file = fopen(tmpFile, "wb");
+  bool success = file != NULL;
+  if (success) {
+    success = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (unsigned i = 0; success && i < CacheSections; i++) {
+      size_t size = cacheSections[i].size;
+      success =  fwrite(*cacheSections[i].data, 1, size, file) == size
+              && fwrite(zeros, 1, CacheAlign(size) - size, file) == CacheAlign(size) - size;
+    }
+    success = fclose(file) == 0 && success;
+  }
+
+  if (success && rename(tmpFile, cacheFile) != 0) {
+    remove(cacheFile);
+    success = rename(tmpFile, cacheFile) == 0;
+  }
+  if (!success) remove(tmpFile);
+
+  free(tmpFile);
+  return success;
+}
+
 static bool load_eval_file(const char *evalFile)
 {
   const void *evalData;
   map_t mapping;
   size_t size;
 
+  release_cache();
+
 #ifdef NNUE_EMBEDDED
   if (strcmp(evalFile, DefaultEvalFile) == 0) {
     evalData = gNetworkData;
@@ -1253,8 +1487,20 @@ static bool load_eval_file(const char *evalFile)
   {
     FD fd = open_file(evalFile);
     if (fd == FD_ERR) return false;
-    evalData = map_file(fd, &mapping);
     size = file_size(fd);
+    netSize = size;
+    netTime = file_time(fd);
+
+    // Zero-copy load from a matching cache
+    char *cacheFile = cache_file_name(evalFile);
+    bool cached = map_cache(cacheFile);
+    free(cacheFile);
+    if (cached) {
+      close_file(fd);
+      return true;
+    }
+
+    evalData = map_file(fd, &mapping);
     close_file(fd);
   }
 
@@ -1282,7 +1528,7 @@ DLLExport void _CDECL nnue_init(const char* evalFile)
   fflush(stdout);
   if (load_eval_file(evalFile)) {
     loadedFile = strdup(evalFile);
-    printf("NNUE loaded !\n");
+    printf(cacheData ? "NNUE loaded from cache !\n" : "NNUE loaded !\n");
     fflush(stdout);
     return;
   }
@@ -1291,15 +1537,53 @@ DLLExport void _CDECL nnue_init(const char* evalFile)
   fflush(stdout);
 }
 
-DLLExport int _CDECL nnue_evaluate(int player, int* pieces, int* squares)
+DLLExport bool _CDECL nnue_write_cache(void)
+{
+  if (!loadedFile)
+    return false;
+
+  char *cacheFile = cache_file_name(loadedFile);
+  bool success = cacheData || write_cache(cacheFile);
+  printf(success ? "NNUE cache : %s\n" : "Unable to write NNUE cache %s\n", cacheFile);
+  fflush(stdout);
+
+  free(cacheFile);
+  return success;
+}
+
+DLLExport int _CDECL nnue_evaluate_incremental(int player, int* pieces,
+    int* squares, NNUEdata** nnue)
 {
   Position pos;
   pos.player = player;
   pos.pieces = pieces;
   pos.squares = squares;
+  pos.nnue = nnue;
   return nnue_evaluate_pos(&pos);
 }
 
+DLLExport int _CDECL nnue_evaluate(int player, int* pieces, int* squares)
+{
+  NNUEdata data;
+  NNUEdata* nnue[2] = { &data, NULL };
+  data.accumulator.computedAccumulation = false;
+  return nnue_evaluate_incremental(player, pieces, squares, nnue);
+}
+
+DLLExport void _CDECL nnue_evaluate_batch_order(int n, const int* order,
+    int* players, int (*pieces)[33], int (*squares)[33], int* out)
+{
+  NNUEdata data;
+  NNUEdata* nnue[2] = { &data, NULL };
+
+  for (int b = 0; b < n; b++) {
+    const int index = order ? order[b] : b;
+    data.accumulator.computedAccumulation = false;
+    out[index] = nnue_evaluate_incremental(players[index], pieces[index],
+        squares[index], nnue);
+  }
+}
+
 DLLExport int _CDECL nnue_evaluate_fen(const char* fen)
 {
   int pieces[33],squares[33],player,castle,fifty,move_number;
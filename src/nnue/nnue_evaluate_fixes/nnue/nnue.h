@@ -23,6 +23,24 @@
 #   define DLLExport EXTERNC
 #endif
 
+/*
+* SIMD backends: nnue.cpp is compiled once per instruction set with
+* NNUE_BACKEND set to the backend name, which suffixes its symbols
+* (nnue_init_avx2 etc). nnue_dispatch.cpp exports the plain names and
+* forwards them to the fastest backend supported by the CPU.
+*/
+#ifdef NNUE_BACKEND
+#define NNUE_NAME_(name, backend) name##_##backend
+#define NNUE_NAME(name, backend) NNUE_NAME_(name, backend)
+#define nnue_init NNUE_NAME(nnue_init, NNUE_BACKEND)
+#define nnue_evaluate_fen NNUE_NAME(nnue_evaluate_fen, NNUE_BACKEND)
+#define nnue_evaluate NNUE_NAME(nnue_evaluate, NNUE_BACKEND)
+#define nnue_evaluate_incremental NNUE_NAME(nnue_evaluate_incremental, NNUE_BACKEND)
+#define nnue_evaluate_pos NNUE_NAME(nnue_evaluate_pos, NNUE_BACKEND)
+#define nnue_evaluate_batch_order NNUE_NAME(nnue_evaluate_batch_order, NNUE_BACKEND)
+#define nnue_write_cache NNUE_NAME(nnue_write_cache, NNUE_BACKEND)
+#endif
+
 /*pieces*/
 enum colors {
     white,black
@@ -39,29 +57,14 @@ const int pic_tab[14] = {
 #define COMBINE(c,x)     ((x) + (c) * 6) 
 
 /*nnue data*/
-#if 0
-typedef struct DirtyPiece {
-  int dirtyNum;
-  int pc[3];
-  int from[3];
-  int to[3];
-} DirtyPiece;
-#endif
-
-typedef struct {
-  alignas(64) int16_t accumulation[2][256];
-  bool computedAccumulation;
-} Accumulator;
+#include "nnue_data.h"
 
 /*position*/
 typedef struct Position {
   int player;
   int* pieces;
   int* squares;
-  Accumulator accumulator;
-#if 0
-  DirtyPiece dirtyPiece;
-#endif
+  NNUEdata** nnue;
 } Position;
 
 int nnue_evaluate_pos(Position* pos);
@@ -73,6 +76,14 @@ DLLExport void _CDECL nnue_init(
   const char * evalFile             /** Path to NNUE file */
 );
 
+/**
+* Write the loaded network in the layout of the SIMD backend in use
+* to "<evalFile>.<backend>.cache". Later nnue_init() calls map that
+* cache read-only instead of reading the network, so processes share
+* its pages. The cache is ignored once the network file changes.
+*/
+DLLExport bool _CDECL nnue_write_cache(void);
+
 /**
 * Evaluate on FEN string
 */
@@ -102,5 +113,66 @@ DLLExport int _CDECL nnue_evaluate(
   int* squares                      /** Corresponding array of squares the piece stand on */
 );
 
+/**
+* Incremental evaluation subroutine suitable for chess engines.
+* -------------------------------------------------------------
+* Same input as nnue_evaluate() plus the accumulator history:
+*     nnue[0] is the data of the current position,
+*     nnue[1] is the data of its parent position and so on,
+*     the list is terminated with NULL.
+* Each entry holds the pieces that changed on the move leading to
+* it (dirtyPiece) and its accumulator. Accumulators are updated
+* from the nearest computed ancestor using the changed features only,
+* a king move forces a full refresh for that king's perspective.
+*/
+DLLExport int _CDECL nnue_evaluate_incremental(
+  int player,                       /** Side to move */
+  int* pieces,                      /** Array of pieces */
+  int* squares,                     /** Corresponding array of squares the piece stand on */
+  NNUEdata** nnue                   /** Accumulator history, current position first */
+);
+
+/**
+* Batch evaluation subroutine for labelling large sets of positions.
+* -------------------------------------------------------------------
+* Same input as nnue_evaluate() for n positions, the scores are
+* written to out[]. Positions are evaluated grouped by king squares,
+* so the feature transformer rows of a group stay in cache while its
+* accumulators are refreshed. Groups are spread over the given number
+* of threads.
+*/
+DLLExport void _CDECL nnue_evaluate_batch(
+  int n,                            /** Number of positions */
+  int* players,                     /** Side to move of each position */
+  int (*pieces)[33],                /** Arrays of pieces */
+  int (*squares)[33],               /** Corresponding arrays of squares */
+  int* out,                         /** Scores */
+  int threads                       /** Number of threads to use */
+);
+
+/**
+* Same as nnue_evaluate_batch() in a single thread, positions are
+* evaluated in the given order (NULL means as stored)
+*/
+DLLExport void _CDECL nnue_evaluate_batch_order(
+  int n,                            /** Number of positions */
+  const int* order,                 /** Indices of positions to evaluate */
+  int* players,                     /** Side to move of each position */
+  int (*pieces)[33],                /** Arrays of pieces */
+  int (*squares)[33],               /** Corresponding arrays of squares */
+  int* out                          /** Scores */
+);
+
+/**
+* Name of the SIMD backend in use
+*/
+DLLExport const char* _CDECL nnue_backend(void);
+
+/**
+* Benchmark every SIMD backend supported by the CPU,
+* prints evaluations per second for each of them
+*/
+DLLExport void _CDECL nnue_bench(void);
+
 
 #endif
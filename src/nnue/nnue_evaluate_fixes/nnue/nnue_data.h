@@ -0,0 +1,33 @@
+#ifndef NNUE_DATA_H
+#define NNUE_DATA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdalign.h>
+
+/*
+Accumulator data kept by the engine for every ply so that
+the feature transformer can be updated incrementally.
+This header is free of any board definitions and may be
+included directly by C chess engines.
+*/
+
+/*pieces changed by the last move (stockfish piece & square codes)*/
+typedef struct DirtyPiece {
+  int dirtyNum;
+  int pc[3];
+  int from[3];
+  int to[3];
+} DirtyPiece;
+
+typedef struct Accumulator {
+  alignas(64) int16_t accumulation[2][256];
+  bool computedAccumulation;
+} Accumulator;
+
+typedef struct NNUEdata {
+  Accumulator accumulator;
+  DirtyPiece dirtyPiece;
+} NNUEdata;
+
+#endif
@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#define DLL_EXPORT
+#include "nnue.h"
+#undef DLL_EXPORT
+
+/*
+Backends compiled from nnue.cpp, fastest first
+*/
+#if defined(__x86_64__) || defined(__i386__)
+#define NNUE_BACKENDS(X) \
+  X(avx512vnni, __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni")) \
+  X(avx512,     __builtin_cpu_supports("avx512bw")) \
+  X(avxvnni,    __builtin_cpu_supports("avx2") && __builtin_cpu_supports("avxvnni")) \
+  X(avx2,       __builtin_cpu_supports("avx2")) \
+  X(sse41,      __builtin_cpu_supports("sse4.1")) \
+  X(ssse3,      __builtin_cpu_supports("ssse3")) \
+  X(sse2,       __builtin_cpu_supports("sse2")) \
+  X(generic,    true)
+#else
+#define NNUE_BACKENDS(X) \
+  X(generic,    true)
+#endif
+
+#define NNUE_DECLARE_BACKEND(name, supported) \
+  EXTERNC void nnue_init_##name(const char* evalFile); \
+  EXTERNC int nnue_evaluate_fen_##name(const char* fen); \
+  EXTERNC int nnue_evaluate_##name(int player, int* pieces, int* squares); \
+  EXTERNC int nnue_evaluate_incremental_##name(int player, int* pieces, \
+      int* squares, NNUEdata** nnue); \
+  EXTERNC bool nnue_write_cache_##name(void); \
+  EXTERNC void nnue_evaluate_batch_order_##name(int n, const int* order, \
+      int* players, int (*pieces)[33], int (*squares)[33], int* out);
+NNUE_BACKENDS(NNUE_DECLARE_BACKEND)
+
+typedef struct {
+  const char *name;
+  void (*init)(const char *evalFile);
+  int (*evaluate_fen)(const char *fen);
+  int (*evaluate)(int player, int *pieces, int *squares);
+  int (*evaluate_incremental)(int player, int *pieces, int *squares,
+      NNUEdata **nnue);
+  bool (*write_cache)(void);
+  void (*evaluate_batch_order)(int n, const int *order, int *players,
+      int (*pieces)[33], int (*squares)[33], int *out);
+} Backend;
+
+#define NNUE_BACKEND_ENTRY(name, supported) \
+  { #name, nnue_init_##name, nnue_evaluate_fen_##name, \
+    nnue_evaluate_##name, nnue_evaluate_incremental_##name, \
+    nnue_write_cache_##name, nnue_evaluate_batch_order_##name },
+static const Backend backends[] = { NNUE_BACKENDS(NNUE_BACKEND_ENTRY) };
+
+enum { NumBackends = sizeof(backends) / sizeof(backends[0]) };
+
+static bool supported[NumBackends];
+static const Backend *backend = NULL;
+static char *evalFileName = NULL;
+
+// Detect supported backends and pick the fastest one
+static void select_backend(void)
+{
+  if (backend) return;
+
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+#endif
+
+  unsigned i = 0;
+#define NNUE_BACKEND_SUPPORTED(name, isSupported) supported[i++] = isSupported;
+  NNUE_BACKENDS(NNUE_BACKEND_SUPPORTED)
+
+  for (i = 0; i < NumBackends && !backend; i++)
+    if (supported[i])
+      backend = &backends[i];
+
+  printf("NNUE backend : %s\n", backend->name);
+  fflush(stdout);
+}
+
+/*
+Interfaces
+*/
+DLLExport void _CDECL nnue_init(const char* evalFile)
+{
+  select_backend();
+
+  if (evalFileName)
+    free(evalFileName);
+  evalFileName = strdup(evalFile);
+
+  backend->init(evalFile);
+}
+
+DLLExport bool _CDECL nnue_write_cache(void)
+{
+  return backend->write_cache();
+}
+
+DLLExport int _CDECL nnue_evaluate_incremental(int player, int* pieces,
+    int* squares, NNUEdata** nnue)
+{
+  return backend->evaluate_incremental(player, pieces, squares, nnue);
+}
+
+DLLExport int _CDECL nnue_evaluate(int player, int* pieces, int* squares)
+{
+  return backend->evaluate(player, pieces, squares);
+}
+
+DLLExport int _CDECL nnue_evaluate_fen(const char* fen)
+{
+  return backend->evaluate_fen(fen);
+}
+
+DLLExport void _CDECL nnue_evaluate_batch_order(int n, const int* order,
+    int* players, int (*pieces)[33], int (*squares)[33], int* out)
+{
+  backend->evaluate_batch_order(n, order, players, pieces, squares, out);
+}
+
+typedef struct {
+  pthread_t thread;
+  int n;
+  const int *order;
+  int *players;
+  int (*pieces)[33];
+  int (*squares)[33];
+  int *out;
+} BatchSlice;
+
+static void *evaluate_batch_slice(void *arg)
+{
+  BatchSlice *slice = (BatchSlice *)arg;
+  backend->evaluate_batch_order(slice->n, slice->order, slice->players,
+      slice->pieces, slice->squares, slice->out);
+  return NULL;
+}
+
+DLLExport void _CDECL nnue_evaluate_batch(int n, int* players,
+    int (*pieces)[33], int (*squares)[33], int* out, int threads)
+{
+  if (n <= 0) return;
+  if (threads < 1) threads = 1;
+  if (threads > n) threads = n;
+
+  // Group positions by king squares (counting sort, stable)
+  int *order = (int *)malloc(n * sizeof(int));
+  int *start = (int *)calloc(64 * 64 + 1, sizeof(int));
+  for (int i = 0; i < n; i++)
+    start[squares[i][0] * 64 + squares[i][1] + 1]++;
+  for (int key = 0; key < 64 * 64; key++)
+    start[key + 1] += start[key];
+  for (int i = 0; i < n; i++)
+    order[start[squares[i][0] * 64 + squares[i][1]]++] = i;
+
+  // Spread contiguous slices of the grouped order over the threads
+  BatchSlice *slices = (BatchSlice *)malloc(threads * sizeof(BatchSlice));
+  for (int t = 0; t < threads; t++) {
+    int first = (int)((long long)n * t / threads);
+    int last = (int)((long long)n * (t + 1) / threads);
+    slices[t].n = last - first;
+    slices[t].order = order + first;
+    slices[t].players = players;
+    slices[t].pieces = pieces;
+    slices[t].squares = squares;
+    slices[t].out = out;
+    if (t > 0)
+      pthread_create(&slices[t].thread, NULL, evaluate_batch_slice, &slices[t]);
+  }
+  evaluate_batch_slice(&slices[0]);
+  for (int t = 1; t < threads; t++)
+    pthread_join(slices[t].thread, NULL);
+
+  free(slices);
+  free(start);
+  free(order);
+}
+
+DLLExport const char* _CDECL nnue_backend(void)
+{
+  select_backend();
+  return backend->name;
+}
+
+DLLExport void _CDECL nnue_bench(void)
+{
+  static const char *fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "rnbqkb1r/pp1p1ppp/2p5/4P3/2B5/8/PPP1NnPP/RNBQK2R w KQkq - 0 6",
+    "2r3k1/pp3ppp/4p3/3pP3/3P4/P4N2/1P3PPP/2R3K1 b - - 3 24",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"
+  };
+  enum { NumFens = sizeof(fens) / sizeof(fens[0]), Rounds = 20000 };
+
+  int pieces[NumFens][33], squares[NumFens][33], player[NumFens];
+  int castle, fifty, move_number;
+
+  select_backend();
+
+  if (!evalFileName) {
+    printf("NNUE is not loaded\n");
+    return;
+  }
+
+  for (unsigned f = 0; f < NumFens; f++)
+    decode_fen(fens[f], &player[f], &castle, &fifty, &move_number,
+        pieces[f], squares[f]);
+
+  for (unsigned i = 0; i < NumBackends; i++) {
+    if (!supported[i]) continue;
+
+    // every backend keeps its own copy of the weights
+    if (&backends[i] != backend)
+      backends[i].init(evalFileName);
+
+    clock_t start = clock();
+    long long checksum = 0;
+    for (unsigned r = 0; r < Rounds; r++)
+      for (unsigned f = 0; f < NumFens; f++)
+        checksum += backends[i].evaluate(player[f], pieces[f], squares[f]);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (seconds <= 0) seconds = 1e-9;
+
+    printf("%-12s %10.0f evals/s  checksum %lld%s\n", backends[i].name,
+        Rounds * NumFens / seconds, checksum,
+        &backends[i] == backend ? "  (active)" : "");
+    fflush(stdout);
+  }
+}
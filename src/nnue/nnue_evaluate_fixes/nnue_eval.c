@@ -15,13 +15,41 @@ void init_nnue(char *filename)
 int evaluate_nnue(int player, int *pieces, int *squares)
 {
     // call NNUE probe lib function
-    nnue_evaluate(player, pieces, squares);
+    return nnue_evaluate(player, pieces, squares);
+}
+
+// get NNUE score updating accumulators incrementally
+int evaluate_nnue_incremental(int player, int *pieces, int *squares, NNUEdata **nnue)
+{
+    // call NNUE probe lib function
+    return nnue_evaluate_incremental(player, pieces, squares, nnue);
+}
+
+// get NNUE scores for a batch of positions
+void evaluate_batch_nnue(int n, int *players, int (*pieces)[33], int (*squares)[33], int *scores, int threads)
+{
+    // call NNUE probe lib function
+    nnue_evaluate_batch(n, players, pieces, squares, scores, threads);
+}
+
+// benchmark NNUE SIMD backends
+void bench_nnue()
+{
+    // call NNUE probe lib function
+    nnue_bench();
+}
+
+// write pre-permuted NNUE weights for zero-copy loading
+int write_cache_nnue()
+{
+    // call NNUE probe lib function
+    return nnue_write_cache();
 }
 
 // det NNUE score from FEN input
 int evaluate_fen_nnue(char *fen)
 {
     // call NNUE probe lib function
-    nnue_evaluate_fen(fen);
+    return nnue_evaluate_fen(fen);
 }
 
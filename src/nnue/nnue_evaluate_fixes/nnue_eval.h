@@ -1,4 +1,11 @@
+/* NNUE accumulator data types */
+#include "./nnue/nnue_data.h"
+
 /* NNUE wrapper function headers */
 void init_nnue(char *filename);
 int evaluate_nnue(int player, int *pieces, int *squares);
+int evaluate_nnue_incremental(int player, int *pieces, int *squares, NNUEdata **nnue);
 int evaluate_fen_nnue(char *fen);
+void evaluate_batch_nnue(int n, int *players, int (*pieces)[33], int (*squares)[33], int *scores, int threads);
+void bench_nnue();
+int write_cache_nnue();